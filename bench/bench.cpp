@@ -0,0 +1,463 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
+
+#include "../src/ast/stmt.hpp"
+#include "../src/codegen/llvm.hpp"
+#include "../src/driver/driver.hpp"
+#include "../src/error/error.hpp"
+#include "../src/lexer/lexer.hpp"
+#include "../src/memory/memory.hpp"
+#include "../src/parser/parser.hpp"
+#include "corpus.hpp"
+
+/*
+ * zura2_bench [flags]
+ *
+ * Generates every corpus (see corpus.hpp) and measures how fast each layer
+ * of the compiler gets through it, on one thread:
+ *
+ *   lex       Lexer::lexer::scan_token until eof
+ *   parse     Parser::parse over the tokens
+ *   lower     Codegen::lower_partition of every partition
+ *   optimize  Codegen::optimize of every partition
+ *   emit      Codegen::emit_object of every partition
+ *
+ * Each layer runs --repeat times, and on small corpora for at least 50ms,
+ * and the fastest run counts. Throughput is in MB of source and in tokens
+ * per second, printed as JSON.
+ *
+ *   --sizes <list>   corpus sizes, 1K,64K,1M,16M by default, up to 500M
+ *   --shapes <list>  exprs,functions,loops,prints by default
+ *   --repeat <n>     3 by default
+ *   --max-parse <size>    larger corpora are only lexed, 64M by default
+ *   --max-codegen <size>  larger corpora are not lowered, 4M by default
+ *   --out <file>     write the JSON to <file> instead of stdout
+ *   --compare <file>  compare with the JSON of an earlier run and exit
+ *                     with 1 when a layer lost more than --threshold
+ *                     percent (10 by default) of its throughput
+ *   --emit <shape> <size>  print one corpus and exit
+ */
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  std::string shape;
+  std::size_t size, bytes, tokens;
+  std::string layer;
+  double seconds;
+
+  double mb_per_s() const { return double(bytes) / 1e6 / seconds; }
+  double tokens_per_s() const { return double(tokens) / seconds; }
+};
+
+struct Config {
+  std::vector<std::size_t> sizes = {1 << 10, 64 << 10, 1 << 20, 16 << 20};
+  std::vector<Bench::Shape> shapes = {std::begin(Bench::shapes),
+                                      std::end(Bench::shapes)};
+  std::size_t repeat = 3;
+  std::size_t max_parse = std::size_t(64) << 20;
+  std::size_t max_codegen = std::size_t(4) << 20;
+  std::string out, compare;
+  double threshold = 10.0;
+};
+
+// 64K, 1M, 500M or a plain byte count
+bool parse_size(const std::string &text, std::size_t &size) {
+  std::size_t end;
+  try {
+    size = std::stoul(text, &end);
+  } catch (const std::exception &) {
+    return false;
+  }
+  std::string unit = text.substr(end);
+  if (unit == "K" || unit == "k")
+    size <<= 10;
+  else if (unit == "M" || unit == "m")
+    size <<= 20;
+  else if (unit == "G" || unit == "g")
+    size <<= 30;
+  else if (!unit.empty())
+    return false;
+  return size > 0;
+}
+
+std::vector<std::string> split(const std::string &list) {
+  std::vector<std::string> items;
+  std::size_t start = 0;
+  while (start <= list.size()) {
+    std::size_t comma = list.find(',', start);
+    if (comma == std::string::npos)
+      comma = list.size();
+    if (comma > start)
+      items.push_back(list.substr(start, comma - start));
+    start = comma + 1;
+  }
+  return items;
+}
+
+std::string size_name(std::size_t size) {
+  if (size % (1 << 20) == 0)
+    return std::to_string(size >> 20) + "M";
+  if (size % (1 << 10) == 0)
+    return std::to_string(size >> 10) + "K";
+  return std::to_string(size);
+}
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Runs at least `repeat` times, and more until 50ms have passed, so
+// corpora that take microseconds are not measured by a single sample
+struct Runs {
+  std::size_t repeat;
+  Clock::time_point begin = Clock::now();
+  std::size_t done = 0;
+
+  bool more() {
+    return done++ < repeat ||
+           (seconds_since(begin) < 0.05 && done <= 1000);
+  }
+};
+
+// Fastest of the runs
+double best_of(std::size_t repeat, const std::function<void()> &run) {
+  double best = 0;
+  for (Runs runs{repeat}; runs.more();) {
+    Clock::time_point start = Clock::now();
+    run();
+    double took = seconds_since(start);
+    if (runs.done == 1 || took < best)
+      best = took;
+  }
+  return best;
+}
+
+std::size_t count_tokens(const std::string &source) {
+  Lexer::lexer lx;
+  lx.init_lexer(&lx, source.c_str());
+  std::size_t n = 0;
+  while (lx.scan_token().kind != Lexer::Kind::eof)
+    n++;
+  return n + 1;
+}
+
+std::vector<Lexer::Token> tokens_of(const std::string &source) {
+  Lexer::lexer lx;
+  lx.init_lexer(&lx, source.c_str());
+  std::vector<Lexer::Token> tks;
+  while (true) {
+    tks.push_back(lx.scan_token());
+    if (tks.back().kind == Lexer::Kind::eof)
+      return tks;
+  }
+}
+
+// A corpus that does not compile is a bug in the generator
+bool check(const char *layer, const std::string &shape) {
+  if (Error::errors.empty())
+    return true;
+  std::cerr << "The " << shape << " corpus failed to " << layer << ":\n";
+  Error::report_error(std::cerr);
+  Error::errors.clear();
+  return false;
+}
+
+// Lowers, optimizes and emits every partition in turn, adding up the time
+// spent in each layer
+bool codegen(const ProgramStmt *program, const std::string &object,
+             double (&took)[3]) {
+  llvm::TargetMachine *tm = Codegen::thread_target_machine();
+  if (!tm)
+    return false;
+
+  took[0] = took[1] = took[2] = 0;
+  for (const auto &stmts :
+       Codegen::partition(program, Driver::fns_per_partition)) {
+    CodegenContext cg("bench");
+    cg.module->setTargetTriple(tm->getTargetTriple().str());
+    cg.module->setDataLayout(tm->createDataLayout());
+
+    Clock::time_point start = Clock::now();
+    if (!Codegen::lower_partition(program, stmts, {}, cg))
+      return false;
+    took[0] += seconds_since(start);
+
+    start = Clock::now();
+    Codegen::optimize(*cg.module, *tm);
+    took[1] += seconds_since(start);
+
+    start = Clock::now();
+    if (!Codegen::emit_object(*cg.module, *tm, object))
+      return false;
+    took[2] += seconds_since(start);
+  }
+  return true;
+}
+
+bool run_shape(const Config &config, Bench::Shape shape, std::size_t size,
+               const std::string &object, std::vector<Result> &results) {
+  std::string name = Bench::shape_name(shape);
+  std::string source = Bench::generate(shape, size);
+  Error::file = name + "-" + size_name(size) + ".zu";
+  std::cerr << name << " " << size_name(size) << ": " << source.size()
+            << " bytes" << std::flush;
+
+  std::size_t tokens = 0;
+  double lex = best_of(config.repeat, [&] { tokens = count_tokens(source); });
+  if (!check("lex", name))
+    return false;
+  Result base{name, size, source.size(), tokens, "", 0};
+  results.push_back(base);
+  results.back().layer = "lex";
+  results.back().seconds = lex;
+
+  if (size > config.max_parse) {
+    std::cerr << ", only lexed\n";
+    return true;
+  }
+
+  std::vector<Lexer::Token> tks = tokens_of(source);
+  Node::Stmt *program = nullptr;
+  std::unique_ptr<Allocator::ArenaAllocator> arena; // of the last program
+  double parse = 0;
+  for (Runs runs{config.repeat}; runs.more();) {
+    arena = std::make_unique<Allocator::ArenaAllocator>(1024);
+    std::vector<Lexer::Token> copy = tks; // parse() takes them over
+    Clock::time_point start = Clock::now();
+    program = Parser::parse(std::move(copy), *arena);
+    double took = seconds_since(start);
+    parse = runs.done == 1 ? took : std::min(parse, took);
+  }
+  if (!check("parse", name))
+    return false;
+  results.push_back(base);
+  results.back().layer = "parse";
+  results.back().seconds = parse;
+
+  if (size > config.max_codegen) {
+    std::cerr << ", not lowered\n";
+    return true;
+  }
+
+  const char *layers[3] = {"lower", "optimize", "emit"};
+  double best[3] = {0, 0, 0};
+  for (Runs runs{config.repeat}; runs.more();) {
+    double took[3];
+    if (!codegen(static_cast<ProgramStmt *>(program), object, took)) {
+      std::cerr << "\nThe " << name << " corpus failed to compile\n";
+      return false;
+    }
+    for (int l = 0; l < 3; l++)
+      best[l] = runs.done == 1 ? took[l] : std::min(best[l], took[l]);
+  }
+  for (int l = 0; l < 3; l++) {
+    results.push_back(base);
+    results.back().layer = layers[l];
+    results.back().seconds = best[l];
+  }
+  std::cerr << "\n";
+  return true;
+}
+
+void write_json(llvm::raw_ostream &os, const Config &config,
+                const std::vector<Result> &results) {
+  llvm::json::OStream j(os, 2);
+  j.object([&] {
+    j.attribute("version", 1);
+    j.attribute("repeat", std::int64_t(config.repeat));
+    j.attributeArray("results", [&] {
+      for (const Result &r : results) {
+        j.object([&] {
+          j.attribute("shape", r.shape);
+          j.attribute("size", std::int64_t(r.size));
+          j.attribute("layer", r.layer);
+          j.attribute("bytes", std::int64_t(r.bytes));
+          j.attribute("tokens", std::int64_t(r.tokens));
+          j.attribute("seconds", r.seconds);
+          j.attribute("mb_per_s", r.mb_per_s());
+          j.attribute("tokens_per_s", r.tokens_per_s());
+        });
+      }
+    });
+  });
+  os << "\n";
+}
+
+// Returns how many layers regressed, or -1 when the baseline is unreadable
+int compare(const std::string &path, double threshold,
+            const std::vector<Result> &results) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    std::cerr << "Failed to open file: " << path << "\n";
+    return -1;
+  }
+  auto parsed = llvm::json::parse((*buffer)->getBuffer());
+  const llvm::json::Array *baseline = nullptr;
+  if (parsed && parsed->getAsObject())
+    baseline = parsed->getAsObject()->getArray("results");
+  if (baseline == nullptr) {
+    llvm::consumeError(parsed.takeError());
+    std::cerr << path << " is not the output of zura2_bench\n";
+    return -1;
+  }
+
+  int regressions = 0;
+  std::ios::fmtflags flags = std::cerr.flags();
+  std::cerr << std::fixed << std::setprecision(1);
+  for (const Result &r : results) {
+    double before = 0;
+    for (const llvm::json::Value &v : *baseline) {
+      const llvm::json::Object *o = v.getAsObject();
+      if (o == nullptr ||
+          o->getString("shape") != llvm::StringRef(r.shape) ||
+          o->getInteger("size") != std::int64_t(r.size) ||
+          o->getString("layer") != llvm::StringRef(r.layer))
+        continue;
+      before = o->getNumber("mb_per_s").getValueOr(0);
+      break;
+    }
+    if (before <= 0)
+      continue;
+
+    double change = (r.mb_per_s() / before - 1) * 100;
+    bool regressed = change < -threshold;
+    regressions += regressed;
+    std::cerr << std::setw(10) << r.shape << std::setw(6) << size_name(r.size)
+              << std::setw(10) << r.layer << std::setw(12) << before
+              << " -> " << std::setw(10) << r.mb_per_s() << " MB/s "
+              << std::showpos << std::setw(7) << change << std::noshowpos
+              << "%" << (regressed ? "  REGRESSION" : "") << "\n";
+  }
+  std::cerr.flags(flags);
+  return regressions;
+}
+
+bool parse_args(int argc, char *argv[], Config &config) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    std::string value = has_value ? argv[i + 1] : "";
+
+    if (arg == "--emit") {
+      Bench::Shape shape;
+      std::size_t size;
+      if (i + 2 >= argc || !Bench::parse_shape(argv[i + 1], shape) ||
+          !parse_size(argv[i + 2], size)) {
+        std::cerr << "Expected a shape and a size after --emit\n";
+        return false;
+      }
+      std::cout << Bench::generate(shape, size);
+      std::exit(0);
+    }
+    if (!has_value) {
+      std::cerr << "Unknown flag or missing value: " << arg << "\n";
+      return false;
+    }
+    i++;
+
+    if (arg == "--sizes") {
+      config.sizes.clear();
+      for (const std::string &item : split(value)) {
+        std::size_t size;
+        if (!parse_size(item, size)) {
+          std::cerr << "Not a size: " << item << "\n";
+          return false;
+        }
+        config.sizes.push_back(size);
+      }
+    } else if (arg == "--shapes") {
+      config.shapes.clear();
+      for (const std::string &item : split(value)) {
+        Bench::Shape shape;
+        if (!Bench::parse_shape(item, shape)) {
+          std::cerr << "Not a shape: " << item << "\n";
+          return false;
+        }
+        config.shapes.push_back(shape);
+      }
+    } else if (arg == "--repeat" || arg == "--threshold") {
+      try {
+        if (arg == "--repeat")
+          config.repeat = std::max<std::size_t>(1, std::stoul(value));
+        else
+          config.threshold = std::stod(value);
+      } catch (const std::exception &) {
+        std::cerr << "Expected a number after " << arg << "\n";
+        return false;
+      }
+    } else if (arg == "--max-parse" || arg == "--max-codegen") {
+      if (!parse_size(value, arg == "--max-parse" ? config.max_parse
+                                                  : config.max_codegen)) {
+        std::cerr << "Not a size: " << value << "\n";
+        return false;
+      }
+    } else if (arg == "--out") {
+      config.out = value;
+    } else if (arg == "--compare") {
+      config.compare = value;
+    } else {
+      std::cerr << "Unknown flag: " << arg << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parse_args(argc, argv, config))
+    return -1;
+
+  llvm::SmallString<128> object;
+  if (auto EC = llvm::sys::fs::createTemporaryFile("zura2_bench", "o",
+                                                   object)) {
+    std::cerr << "Could not create a temporary file: " << EC.message()
+              << "\n";
+    return -1;
+  }
+
+  std::vector<Result> results;
+  bool ok = true;
+  for (Bench::Shape shape : config.shapes) {
+    for (std::size_t size : config.sizes)
+      ok = run_shape(config, shape, size, std::string(object), results) && ok;
+  }
+  llvm::sys::fs::remove(object);
+
+  if (config.out.empty()) {
+    write_json(llvm::outs(), config, results);
+  } else {
+    std::error_code EC;
+    llvm::raw_fd_ostream os(config.out, EC);
+    if (EC) {
+      std::cerr << "Could not write " << config.out << ": " << EC.message()
+                << "\n";
+      return -1;
+    }
+    write_json(os, config, results);
+  }
+
+  if (!ok)
+    return 2;
+  if (!config.compare.empty()) {
+    int regressions = compare(config.compare, config.threshold, results);
+    if (regressions < 0)
+      return -1;
+    if (regressions > 0)
+      return 1;
+  }
+  return 0;
+}
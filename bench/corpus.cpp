@@ -0,0 +1,208 @@
+#include "corpus.hpp"
+
+#include <string_view>
+
+using namespace Bench;
+
+namespace {
+// splitmix64, small and the same everywhere, unlike <random> distributions
+struct Gen {
+  std::uint64_t state;
+  std::string out;
+
+  std::uint64_t next() {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform enough in [lo, hi] for the small ranges used here
+  std::uint64_t range(std::uint64_t lo, std::uint64_t hi) {
+    return lo + next() % (hi - lo + 1);
+  }
+
+  void lit() { out += std::to_string(range(1, 99)); }
+  void indent(int depth) { out.append(std::size_t(depth) * 2, ' '); }
+};
+
+constexpr std::string_view ops[] = {" + ", " - ", " * ", " / ", " % "};
+constexpr std::string_view words[] = {"alpha", "beta",  "gamma", "delta",
+                                      "value", "count", "total", "line"};
+
+void leaf(Gen &g) {
+  switch (g.range(0, 2)) {
+  case 0:
+    g.out += 'a';
+    break;
+  case 1:
+    g.out += 'b';
+    break;
+  default:
+    g.lit();
+  }
+}
+
+// Leans to the left so the depth grows without the node count exploding
+void expr(Gen &g, int depth) {
+  if (depth == 0) {
+    leaf(g);
+    return;
+  }
+  bool parens = g.range(0, 1) == 0;
+  if (parens)
+    g.out += '(';
+  expr(g, depth - 1);
+  g.out += ops[g.range(0, 4)];
+  if (g.range(0, 3) == 0)
+    expr(g, 1);
+  else
+    leaf(g);
+  if (parens)
+    g.out += ')';
+}
+
+void exprs_fn(Gen &g, std::size_t i) {
+  g.out += "const e" + std::to_string(i) +
+           " := fn (a: int, b: int) int {\n  return ";
+  expr(g, int(g.range(16, 48)));
+  g.out += ";\n};\n";
+}
+
+void functions_fn(Gen &g, std::size_t i) {
+  std::string name = "f" + std::to_string(i);
+  g.out += "const " + name + " := fn (n: int) int {\n  return ";
+  if (i == 0) {
+    g.out += "n + 1;\n};\n";
+    return;
+  }
+  g.out += "f" + std::to_string(g.range(0, i - 1)) + "(n - 1) + f" +
+           std::to_string(g.range(0, i - 1)) + "(n) * ";
+  g.lit();
+  g.out += " + ";
+  g.lit();
+  g.out += ";\n};\n";
+}
+
+void loop_body(Gen &g, int depth, int levels) {
+  std::string v = "v" + std::to_string(depth);
+  g.indent(depth + 1);
+  g.out += "have " + v + ": int = 0;\n";
+  g.indent(depth + 1);
+  g.out += "loop (" + v + " < " +
+           (depth == 0 ? std::string("n") : std::to_string(g.range(2, 64))) +
+           ") : (" + v + "++) {\n";
+  if (depth + 1 < levels) {
+    loop_body(g, depth + 1, levels);
+  } else {
+    g.indent(depth + 2);
+    g.out += "if (" + v + " % ";
+    g.lit();
+    g.out += " == 0) {\n";
+    g.indent(depth + 3);
+    g.out += "@outputln(1, " + v + ", s);\n";
+    g.indent(depth + 2);
+    g.out += "} else {\n";
+    g.indent(depth + 3);
+    g.out += "@output(1, " + v + ");\n";
+    g.indent(depth + 2);
+    g.out += "}\n";
+  }
+  g.indent(depth + 1);
+  g.out += "}\n";
+}
+
+void loops_fn(Gen &g, std::size_t i) {
+  g.out += "const l" + std::to_string(i) +
+           " := fn (n: int) int {\n  have s: int = ";
+  g.lit();
+  g.out += ";\n";
+  loop_body(g, 0, int(g.range(1, 3)));
+  g.out += "  return s;\n};\n";
+}
+
+void prints_fn(Gen &g, std::size_t i) {
+  g.out += "const p" + std::to_string(i) + " := fn (n: int) int {\n";
+  for (std::uint64_t k = 0, lines = g.range(4, 16); k < lines; k++) {
+    g.out += g.range(0, 3) == 0 ? "  @output(1, \"" : "  @outputln(1, \"";
+    for (std::uint64_t w = 0, count = g.range(1, 6); w < count; w++) {
+      if (w != 0)
+        g.out += ' ';
+      g.out += words[g.range(0, 7)];
+    }
+    g.out += " \", n, ";
+    g.lit();
+    g.out += ");\n";
+  }
+  g.out += "  return n;\n};\n";
+}
+} // namespace
+
+const char *Bench::shape_name(Shape shape) {
+  switch (shape) {
+  case Shape::exprs:
+    return "exprs";
+  case Shape::functions:
+    return "functions";
+  case Shape::loops:
+    return "loops";
+  case Shape::prints:
+    return "prints";
+  }
+  return "";
+}
+
+bool Bench::parse_shape(const std::string &name, Shape &shape) {
+  for (Shape s : shapes) {
+    if (name == shape_name(s)) {
+      shape = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string Bench::generate(Shape shape, std::size_t bytes,
+                            std::uint64_t seed) {
+  Gen g{seed * 0x100000001b3ULL + std::uint64_t(shape), {}};
+  g.out.reserve(bytes + 4096);
+  g.out += "@module main;\n";
+
+  std::size_t count = 0;
+  do {
+    switch (shape) {
+    case Shape::exprs:
+      exprs_fn(g, count);
+      break;
+    case Shape::functions:
+      functions_fn(g, count);
+      break;
+    case Shape::loops:
+      loops_fn(g, count);
+      break;
+    case Shape::prints:
+      prints_fn(g, count);
+      break;
+    }
+    count++;
+  } while (g.out.size() < bytes);
+
+  std::string last = std::to_string(count - 1);
+  g.out += "const main := fn () int {\n  return ";
+  switch (shape) {
+  case Shape::exprs:
+    g.out += "e" + last + "(3, 4)";
+    break;
+  case Shape::functions:
+    g.out += "f" + last + "(2)";
+    break;
+  case Shape::loops:
+    g.out += "l" + last + "(8)";
+    break;
+  case Shape::prints:
+    g.out += "p" + last + "(1)";
+    break;
+  }
+  g.out += ";\n};\n";
+  return std::move(g.out);
+}
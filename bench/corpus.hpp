@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Synthetic .zu sources for the benchmarks
+ *
+ * Every shape is a single valid module of top level functions and a main,
+ * grown until it is at least the requested size. The output only depends
+ * on the shape, the size and the seed, so runs on different machines and
+ * commits measure the same input.
+ *
+ *   exprs      deeply nested arithmetic over the parameters
+ *   functions  many small functions calling each other
+ *   loops      nested counting loops with branches in them
+ *   prints     long runs of @output and @outputln
+ */
+
+namespace Bench {
+enum class Shape { exprs, functions, loops, prints };
+
+inline constexpr Shape shapes[] = {Shape::exprs, Shape::functions,
+                                   Shape::loops, Shape::prints};
+
+const char *shape_name(Shape shape);
+bool parse_shape(const std::string &name, Shape &shape);
+
+std::string generate(Shape shape, std::size_t bytes, std::uint64_t seed = 1);
+} // namespace Bench
@@ -0,0 +1,19 @@
+#include <stdint.h>
+#include <stdio.h>
+
+static int64_t steps(int64_t n) {
+  int64_t c = 0;
+  while (n != 1) {
+    n = n % 2 == 0 ? n / 2 : 3 * n + 1;
+    c++;
+  }
+  return c;
+}
+
+int main(void) {
+  int64_t acc = 0;
+  for (int64_t n = 1000000; n != 0; n--)
+    acc += steps(n);
+  printf("%lld\n", (long long)acc);
+  return 0;
+}
@@ -0,0 +1,26 @@
+#include <stdint.h>
+#include <stdio.h>
+
+enum Op { Add, Sub, Mul, Half };
+
+static int64_t apply(enum Op op, int64_t acc, int64_t x) {
+  switch (op) {
+  case Add:
+    return (acc + x) % 1000003;
+  case Sub:
+    return (acc + 1000003 - x % 1000003) % 1000003;
+  case Mul:
+    return (acc * 31 + x) % 1000003;
+  case Half:
+    break;
+  }
+  return acc / 2 + x % 1000;
+}
+
+int main(void) {
+  int64_t acc = 1;
+  for (int64_t i = 0; i < 50000000; i++)
+    acc = apply((enum Op)((i * 7 + acc) % 4), acc, i);
+  printf("%lld\n", (long long)acc);
+  return 0;
+}
@@ -0,0 +1,16 @@
+#include <stdint.h>
+#include <stdio.h>
+
+static int64_t pairs(int64_t n) {
+  int64_t s = 0;
+  for (int64_t i = 0; i < n; i++)
+    for (int64_t j = 0; j < n; j++)
+      if ((i * j + i) % 7 == 3)
+        s++;
+  return s;
+}
+
+int main(void) {
+  printf("%lld\n", (long long)pairs(12000));
+  return 0;
+}
@@ -0,0 +1,8 @@
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void) {
+  for (int64_t i = 0; i < 200000; i++)
+    printf("line %lld %lld\n", (long long)i, (long long)(i * 3));
+  return 0;
+}
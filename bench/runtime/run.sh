@@ -0,0 +1,154 @@
+#!/usr/bin/env bash
+
+# Runtime benchmarks: how fast the code zura2 generates runs, next to the
+# same kernel written in C
+#
+#   bench/runtime/run.sh [-n runs] [-c cpu] [kernel...]
+#
+# Every <kernel>.zu here is built with zura2 and <kernel>.c with $CC -O2.
+# Both have to print the same thing, then each is run -n times (5) pinned
+# to CPU -c (0) with stdout on /dev/null, and the fastest run counts. With
+# perf available the instructions retired are reported too.
+#
+#   ZURA2   the compiler under test, release/zura2 by default
+#   CC      the C compiler, clang by default
+#
+#   fib       recursive calls
+#   loops     nested counting loops with a branch in the body
+#   arith     integer division and multiplication
+#   output    @outputln of strings and integers
+#   dispatch  branching on enum tags
+
+cd "$(dirname "$0")/../.." || exit 1
+
+ZURA2="${ZURA2:-release/zura2}"
+CC="${CC:-clang}"
+RUNS=5
+CPU=0
+
+die() {
+  echo "$1" >&2
+  exit 1
+}
+
+while getopts "n:c:" opt; do
+  case "$opt" in
+    n) RUNS="$OPTARG" ;;
+    c) CPU="$OPTARG" ;;
+    *) die "Usage: $0 [-n runs] [-c cpu] [kernel...]" ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+KERNELS=("$@")
+if [ ${#KERNELS[@]} -eq 0 ]; then
+  for src in bench/runtime/*.zu; do
+    KERNELS+=("$(basename "$src" .zu)")
+  done
+fi
+
+[ -x "$ZURA2" ] || die "No zura2 at $ZURA2, build it or set ZURA2"
+
+PIN=()
+if command -v taskset >/dev/null; then
+  PIN=(taskset -c "$CPU")
+else
+  echo "taskset not found, runs are not pinned" >&2
+fi
+
+PERF=0
+if command -v perf >/dev/null &&
+  perf stat -x, -e instructions:u -o /dev/null true 2>/dev/null; then
+  PERF=1
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+# Fastest of $RUNS runs of $1, in microseconds
+best_time() {
+  local best="" start end us
+  for ((run = 0; run < RUNS; run++)); do
+    start=$(date +%s%N)
+    "${PIN[@]}" "$1" >/dev/null || return 1
+    end=$(date +%s%N)
+    us=$(((end - start) / 1000))
+    if [ -z "$best" ] || [ "$us" -lt "$best" ]; then
+      best=$us
+    fi
+  done
+  echo "$best"
+}
+
+# Instructions retired in user space by one run of $1
+instructions() {
+  perf stat -x, -e instructions:u -o "$WORK/perf" "${PIN[@]}" "$1" \
+    >/dev/null || return 1
+  awk -F, '/instructions/ { print $1 }' "$WORK/perf"
+}
+
+# a / b with two decimals, - when b is 0 or either is missing
+ratio() {
+  awk -v a="$1" -v b="$2" \
+    'BEGIN { if (a == "" || b == "" || b == 0) print "-"; else printf "%.2f", a / b }'
+}
+
+status=0
+if [ "$PERF" -eq 1 ]; then
+  printf "%-10s %10s %10s %7s %14s %14s %7s\n" kernel "zura2 ms" "C ms" ratio \
+    "zura2 insns" "C insns" ratio
+else
+  printf "%-10s %10s %10s %7s\n" kernel "zura2 ms" "C ms" ratio
+fi
+
+for kernel in "${KERNELS[@]}"; do
+  zu="bench/runtime/$kernel.zu"
+  c="bench/runtime/$kernel.c"
+  if [ ! -f "$zu" ] || [ ! -f "$c" ]; then
+    echo "$kernel: needs both $zu and $c" >&2
+    status=1
+    continue
+  fi
+
+  if ! "$ZURA2" build "$zu" -o "$WORK/$kernel.zu" -no-cache >/dev/null; then
+    echo "$kernel: zura2 failed to build $zu" >&2
+    status=1
+    continue
+  fi
+  if ! "$CC" -O2 "$c" -o "$WORK/$kernel.c"; then
+    echo "$kernel: $CC failed to build $c" >&2
+    status=1
+    continue
+  fi
+
+  # A kernel that computes something else measures nothing
+  if ! "$WORK/$kernel.zu" >"$WORK/$kernel.zu.out" ||
+    ! "$WORK/$kernel.c" >"$WORK/$kernel.c.out"; then
+    echo "$kernel: a build exited with an error" >&2
+    status=1
+    continue
+  fi
+  if ! cmp -s "$WORK/$kernel.zu.out" "$WORK/$kernel.c.out"; then
+    echo "$kernel: zura2 and C print different output" >&2
+    status=1
+    continue
+  fi
+
+  zu_us=$(best_time "$WORK/$kernel.zu")
+  c_us=$(best_time "$WORK/$kernel.c")
+  zu_ms=$(awk -v us="$zu_us" 'BEGIN { printf "%.1f", us / 1000 }')
+  c_ms=$(awk -v us="$c_us" 'BEGIN { printf "%.1f", us / 1000 }')
+
+  if [ "$PERF" -eq 1 ]; then
+    zu_insns=$(instructions "$WORK/$kernel.zu")
+    c_insns=$(instructions "$WORK/$kernel.c")
+    printf "%-10s %10s %10s %7s %14s %14s %7s\n" "$kernel" "$zu_ms" "$c_ms" \
+      "$(ratio "$zu_us" "$c_us")" "$zu_insns" "$c_insns" \
+      "$(ratio "$zu_insns" "$c_insns")"
+  else
+    printf "%-10s %10s %10s %7s\n" "$kernel" "$zu_ms" "$c_ms" \
+      "$(ratio "$zu_us" "$c_us")"
+  fi
+done
+
+exit $status
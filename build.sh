@@ -56,11 +56,20 @@ for cmd in "$@"; do
     clean)
       clean
       ;;
+    bench)
+      build "$RELEASE_DIR" || die
+      cmake --build "$RELEASE_DIR" --target zura2_bench || die
+      ./"$RELEASE_DIR"/zura2_bench --out bench.json || die
+      ;;
+    bench-runtime)
+      build "$RELEASE_DIR" || die
+      ZURA2="$RELEASE_DIR/zura2" bench/runtime/run.sh || die
+      ;;
     run)
       run "$2" || die
       ;;
     *)
-      echo "Usage: $0 {debug|release|val|clean|run}" || die
+      echo "Usage: $0 {debug|release|val|clean|run|bench|bench-runtime}" || die
       ;;
   esac
 done
@@ -0,0 +1,27 @@
+// bounds.c
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+// Where an index that failed its bounds check ends up. The check itself is
+// inlined at every index, only the failing path calls out to here.
+_Noreturn void zura_bounds_fail(int64_t index, int64_t len) {
+    static const char index_is[] = "index ";
+    static const char out_of[] = " out of bounds for length ";
+    char msg[96];
+    char *p = msg;
+
+    memcpy(p, index_is, sizeof(index_is) - 1);
+    p += sizeof(index_is) - 1;
+    p += itoa(index, p);
+    memcpy(p, out_of, sizeof(out_of) - 1);
+    p += sizeof(out_of) - 1;
+    p += itoa(len, p);
+    *p++ = '\n';
+
+    write(2, msg, (size_t)(p - msg));
+    exit(1);
+}
@@ -0,0 +1,286 @@
+// dtoa.c
+#include <stdint.h>
+#include <string.h>
+
+#include "runtime.h"
+#include "ryu_table.h"
+
+// The shortest decimal that reads back as the same double, after Ulf Adams'
+// Ryu (PLDI 2018). No division by anything but constants, no snprintf.
+
+__extension__ typedef unsigned __int128 uint128_t;
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BITS 11
+#define BIAS 1023
+
+// Two digits at a time, "00" to "99"
+static const char digit_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// ceil(log2(5^e)), 1 for e == 0
+static int32_t pow5bits(int32_t e) {
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+static uint32_t log10_pow2(int32_t e) { return ((uint32_t)e * 78913) >> 18; }
+static uint32_t log10_pow5(int32_t e) { return ((uint32_t)e * 732923) >> 20; }
+
+static int multiple_of_pow5(uint64_t v, uint32_t p) {
+    uint32_t count = 0;
+    while (v % 5 == 0) {
+        v /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+static int multiple_of_pow2(uint64_t v, uint32_t p) {
+    return (v & ((1ull << p) - 1)) == 0;
+}
+
+// (m * mul) >> j, where mul is a 125 bit table entry and j > 64
+static uint64_t mul_shift(uint64_t m, const uint64_t *mul, int32_t j) {
+    uint128_t low = (uint128_t)m * mul[0];
+    uint128_t high = (uint128_t)m * mul[1];
+    return (uint64_t)(((low >> 64) + high) >> (j - 64));
+}
+
+// How many decimal digits v has, v < 10^17
+static uint32_t digit_count(uint64_t v) {
+    uint32_t n = 1;
+    while (v >= 10) {
+        v /= 10;
+        n++;
+    }
+    return n;
+}
+
+// value == mantissa * 10^exponent, with as few mantissa digits as round trip
+static void shortest(uint64_t ieee_mantissa, uint32_t ieee_exponent,
+                     uint64_t *mantissa, int32_t *exponent) {
+    int32_t e2;
+    uint64_t m2;
+    if (ieee_exponent == 0) {
+        e2 = 1 - BIAS - MANTISSA_BITS - 2;
+        m2 = ieee_mantissa;
+    } else {
+        e2 = (int32_t)ieee_exponent - BIAS - MANTISSA_BITS - 2;
+        m2 = (1ull << MANTISSA_BITS) | ieee_mantissa;
+    }
+    // Round half to even when reading back, so an even mantissa may take
+    // the bounds of its interval
+    int accept_bounds = (m2 & 1) == 0;
+
+    // The interval of decimals that read back as this double is
+    // [4 * m2 - 1 - mm_shift, 4 * m2 + 2] * 2^e2
+    uint64_t mv = 4 * m2;
+    uint32_t mm_shift = ieee_mantissa != 0 || ieee_exponent <= 1;
+
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    int vm_trailing_zeros = 0, vr_trailing_zeros = 0;
+    if (e2 >= 0) {
+        uint32_t q = log10_pow2(e2) - (e2 > 3);
+        e10 = (int32_t)q;
+        int32_t k = POW5_INV_BITCOUNT + pow5bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = mul_shift(4 * m2, pow5_inv[q], i);
+        vp = mul_shift(4 * m2 + 2, pow5_inv[q], i);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, pow5_inv[q], i);
+        if (q <= 21) {
+            // Only one of mp, mv and mm can be a multiple of 5, if any
+            if (mv % 5 == 0)
+                vr_trailing_zeros = multiple_of_pow5(mv, q);
+            else if (accept_bounds)
+                vm_trailing_zeros = multiple_of_pow5(mv - 1 - mm_shift, q);
+            else
+                vp -= (uint64_t)multiple_of_pow5(mv + 2, q);
+        }
+    } else {
+        uint32_t q = log10_pow5(-e2) - (-e2 > 1);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = pow5bits(i) - POW5_BITCOUNT;
+        int32_t j = (int32_t)q - k;
+        vr = mul_shift(4 * m2, pow5[i], j);
+        vp = mul_shift(4 * m2 + 2, pow5[i], j);
+        vm = mul_shift(4 * m2 - 1 - mm_shift, pow5[i], j);
+        if (q <= 1) {
+            // mv = 4 * m2 always has at least two trailing zero bits
+            vr_trailing_zeros = 1;
+            if (accept_bounds)
+                vm_trailing_zeros = mm_shift == 1;
+            else
+                --vp;
+        } else if (q < 63) {
+            vr_trailing_zeros = multiple_of_pow2(mv, q);
+        }
+    }
+
+    // Drop digits while the interval still holds a shorter decimal
+    int32_t removed = 0;
+    uint32_t last_removed = 0;
+    uint64_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        // Rare, the exact bounds matter
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = (uint32_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = (uint32_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+        }
+        // Exactly halfway rounds to even
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0)
+            last_removed = 4;
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) ||
+                       last_removed >= 5);
+    } else {
+        int round_up = 0;
+        if (vp / 100 > vm / 100) {
+            round_up = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10) {
+            round_up = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+        output = vr + (vr == vm || round_up);
+    }
+
+    *mantissa = output;
+    *exponent = e10 + removed;
+}
+
+// Writes the n digits of v to out
+static void write_digits(char *out, uint64_t v, uint32_t n) {
+    char *ptr = out + n;
+    while (v >= 100) {
+        const char *pair = digit_pairs + (v % 100) * 2;
+        v /= 100;
+        *--ptr = pair[1];
+        *--ptr = pair[0];
+    }
+    if (v >= 10) {
+        const char *pair = digit_pairs + v * 2;
+        *--ptr = pair[1];
+        *--ptr = pair[0];
+    } else {
+        *--ptr = (char)('0' + v);
+    }
+}
+
+// Writes value to the start of str, which needs room for 24 bytes, and
+// returns how many it wrote. The result is not NUL terminated.
+//
+// Values from 1e-4 up to 1e16 are written out in full and always have a
+// fraction ("3.0", "0.001"), others in scientific notation ("1e+16",
+// "2.5e-07"), like Python's repr. Special values are "nan", "inf" and
+// "-inf".
+int64_t dtoa(double value, char *str) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int sign = (int)(bits >> 63);
+    uint64_t ieee_mantissa = bits & ((1ull << MANTISSA_BITS) - 1);
+    uint32_t ieee_exponent =
+        (uint32_t)((bits >> MANTISSA_BITS) & ((1u << EXPONENT_BITS) - 1));
+
+    char *out = str;
+    if (ieee_exponent == (1u << EXPONENT_BITS) - 1 && ieee_mantissa != 0) {
+        memcpy(out, "nan", 3);
+        return 3;
+    }
+    if (sign)
+        *out++ = '-';
+    if (ieee_exponent == (1u << EXPONENT_BITS) - 1) {
+        memcpy(out, "inf", 3);
+        return (out - str) + 3;
+    }
+    if (ieee_exponent == 0 && ieee_mantissa == 0) {
+        memcpy(out, "0.0", 3);
+        return (out - str) + 3;
+    }
+
+    uint64_t mantissa;
+    int32_t exponent;
+    shortest(ieee_mantissa, ieee_exponent, &mantissa, &exponent);
+    uint32_t n = digit_count(mantissa);
+    // Where the decimal point goes, counted from the first digit
+    int32_t point = (int32_t)n + exponent;
+
+    if (point > -4 && point <= 16) {
+        if (point <= 0) {
+            // 0.000ddd
+            *out++ = '0';
+            *out++ = '.';
+            memset(out, '0', (size_t)-point);
+            out += -point;
+            write_digits(out, mantissa, n);
+            out += n;
+        } else if ((uint32_t)point >= n) {
+            // ddd000.0
+            write_digits(out, mantissa, n);
+            memset(out + n, '0', (size_t)point - n);
+            out += point;
+            *out++ = '.';
+            *out++ = '0';
+        } else {
+            // ddd.ddd
+            write_digits(out + 1, mantissa, n);
+            memmove(out, out + 1, (size_t)point);
+            out[point] = '.';
+            out += n + 1;
+        }
+        return out - str;
+    }
+
+    // d.ddde+XX
+    write_digits(out + 1, mantissa, n);
+    out[0] = out[1];
+    if (n > 1) {
+        out[1] = '.';
+        out += n + 1;
+    } else {
+        out += 1;
+    }
+    int32_t e = point - 1;
+    *out++ = 'e';
+    *out++ = e < 0 ? '-' : '+';
+    uint32_t abs_e = (uint32_t)(e < 0 ? -e : e);
+    if (abs_e >= 100) {
+        *out++ = (char)('0' + abs_e / 100);
+        abs_e %= 100;
+    }
+    memcpy(out, digit_pairs + abs_e * 2, 2);
+    out += 2;
+    return out - str;
+}
@@ -1,30 +1,64 @@
 // itoa.c
 #include <stdint.h>
 
-char *itoa(int64_t value, char *str) {
-    char *ptr = str + 20;
-    *ptr = '\0';
+#include "runtime.h"
 
-    int64_t num = value;
-    if (num == 0) {
-        *--ptr = '0';
-        return ptr;
-    }
+// Two digits at a time, "00" to "99"
+static const char digit_pairs[200] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
 
-    int neg = 0;
-    if (num < 0) {
-        neg = 1;
-        num = -num;
+// How many decimal digits v has, at least 1
+static int digit_count(uint64_t v) {
+    int n = 1;
+    for (;;) {
+        if (v < 10)
+            return n;
+        if (v < 100)
+            return n + 1;
+        if (v < 1000)
+            return n + 2;
+        if (v < 10000)
+            return n + 3;
+        v /= 10000;
+        n += 4;
     }
+}
 
-    while (num > 0) {
-        *--ptr = '0' + (num % 10);
-        num /= 10;
+// Writes value in decimal to the start of str, which needs room for 20
+// bytes, and returns how many it wrote. The result is not NUL terminated.
+int64_t itoa(int64_t value, char *str) {
+    char *out = str;
+    // Negated as unsigned, which is defined for INT64_MIN as well
+    uint64_t num = (uint64_t)value;
+    if (value < 0) {
+        *out++ = '-';
+        num = 0 - num;
     }
 
-    if (neg) {
-        *--ptr = '-';
+    int len = digit_count(num);
+    char *ptr = out + len;
+    while (num >= 100) {
+        const char *pair = digit_pairs + (num % 100) * 2;
+        num /= 100;
+        *--ptr = pair[1];
+        *--ptr = pair[0];
+    }
+    if (num >= 10) {
+        const char *pair = digit_pairs + num * 2;
+        *--ptr = pair[1];
+        *--ptr = pair[0];
+    } else {
+        *--ptr = (char)('0' + num);
     }
 
-    return ptr;
+    return (out - str) + len;
 }
@@ -0,0 +1,237 @@
+// parallel.c
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "runtime.h"
+
+// The thread pool behind `loop @parallel`. The compiler turns the body of
+// the loop into a function that runs the iterations [lo, hi) and hands it
+// here with the whole range.
+//
+// Every thread of the pool, and the thread that starts loops, owns a deque
+// of ranges still to run. A thread works on one range at a time. While some
+// other thread is idle it splits the range in half and pushes the upper half
+// to the bottom of its deque, otherwise it runs the range a grain at a time.
+// So chunks start big and only get as small as the load asks for. An idle
+// thread steals from the top of another's deque, where the oldest and so
+// biggest ranges are.
+//
+// This file is only in the archive, not in runtime.bc, as a copy linked into
+// every partition would be a pool each.
+
+#define MAX_THREADS 256
+#define DEQUE_SIZE 256 // a power of two
+
+typedef void (*body_fn)(int64_t lo, int64_t hi, void *env);
+
+struct job {
+    body_fn body;
+    void *env;
+    int64_t grain;
+    _Atomic int64_t left; // iterations not run yet
+};
+
+struct task {
+    struct job *job;
+    int64_t lo, hi;
+};
+
+// A slot's fields are atomics so a thief reading one the owner is reusing
+// reads stale values instead of racing, and then fails its CAS on top
+struct slot {
+    _Atomic(struct job *) job;
+    _Atomic int64_t lo, hi;
+};
+
+// A Chase-Lev deque of fixed size. The owner pushes and pops at the bottom,
+// thieves take from the top. A push to a full deque fails, and the owner
+// runs the range itself.
+struct deque {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    struct slot slots[DEQUE_SIZE];
+};
+
+static struct deque deques[MAX_THREADS];
+static int threads = 1;
+static _Atomic int idle;  // pool threads with nothing to run
+static _Atomic int loops; // loops running, pool threads sleep when none are
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_once_t started = PTHREAD_ONCE_INIT;
+
+// The deque of the running thread. Any thread outside the pool uses 0,
+// programs only start loops from the main thread or from inside a body.
+static _Thread_local int self;
+static _Thread_local uint64_t seed;
+
+static int push(struct deque *d, struct job *job, int64_t lo, int64_t hi) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= DEQUE_SIZE)
+        return 0;
+    struct slot *s = &d->slots[b & (DEQUE_SIZE - 1)];
+    atomic_store_explicit(&s->job, job, memory_order_relaxed);
+    atomic_store_explicit(&s->lo, lo, memory_order_relaxed);
+    atomic_store_explicit(&s->hi, hi, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+static void read_slot(struct deque *d, int64_t i, struct task *task) {
+    struct slot *s = &d->slots[i & (DEQUE_SIZE - 1)];
+    task->job = atomic_load_explicit(&s->job, memory_order_relaxed);
+    task->lo = atomic_load_explicit(&s->lo, memory_order_relaxed);
+    task->hi = atomic_load_explicit(&s->hi, memory_order_relaxed);
+}
+
+static int pop(struct deque *d, struct task *task) {
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    read_slot(d, b, task);
+    if (t < b)
+        return 1;
+    // The last range, which a thief may be taking at the same time
+    int won = atomic_compare_exchange_strong_explicit(
+        &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return won;
+}
+
+static int steal(struct deque *d, struct task *task) {
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return 0;
+    read_slot(d, t, task);
+    return atomic_compare_exchange_strong_explicit(
+        &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+// A range from this thread's own deque, or stolen from a random other one
+static int find(struct task *task) {
+    if (pop(&deques[self], task))
+        return 1;
+    if (seed == 0)
+        seed = (uint64_t)(self + 1) * 0x9e3779b97f4a7c15u;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    int first = (int)(seed % (uint64_t)threads);
+    for (int i = 0; i < threads; i++) {
+        int victim = (first + i) % threads;
+        if (victim != self && steal(&deques[victim], task))
+            return 1;
+    }
+    return 0;
+}
+
+static void run(struct job *job, int64_t lo, int64_t hi) {
+    int64_t ran = 0;
+    while (hi - lo > job->grain) {
+        if (atomic_load_explicit(&idle, memory_order_relaxed) > 0) {
+            int64_t mid = lo + (hi - lo) / 2;
+            if (push(&deques[self], job, mid, hi)) {
+                hi = mid;
+                continue;
+            }
+        }
+        job->body(lo, lo + job->grain, job->env);
+        lo += job->grain;
+        ran += job->grain;
+    }
+    job->body(lo, hi, job->env);
+    ran += hi - lo;
+    // Nothing may touch the job after this, its loop can return
+    atomic_fetch_sub_explicit(&job->left, ran, memory_order_release);
+}
+
+static void *worker(void *arg) {
+    self = (int)(intptr_t)arg;
+    struct task task;
+    for (;;) {
+        if (find(&task)) {
+            atomic_fetch_sub_explicit(&idle, 1, memory_order_relaxed);
+            run(task.job, task.lo, task.hi);
+            atomic_fetch_add_explicit(&idle, 1, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_load_explicit(&loops, memory_order_acquire) > 0) {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&lock);
+        while (atomic_load_explicit(&loops, memory_order_acquire) == 0)
+            pthread_cond_wait(&wake, &lock);
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+// One thread per core, or ZURA_THREADS of them. A thread that cannot be
+// started leaves its deque empty and the others do its share.
+static void start_pool(void) {
+    const char *env = getenv("ZURA_THREADS");
+    long n = env ? strtol(env, NULL, 10) : 0;
+    if (n <= 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1)
+        n = 1;
+    threads = n > MAX_THREADS ? MAX_THREADS : (int)n;
+
+    for (int i = 1; i < threads; i++) {
+        pthread_t thread;
+        atomic_fetch_add_explicit(&idle, 1, memory_order_relaxed);
+        if (pthread_create(&thread, NULL, worker, (void *)(intptr_t)i) != 0) {
+            atomic_fetch_sub_explicit(&idle, 1, memory_order_relaxed);
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+// Runs body over [start, end) on the pool and returns once every iteration
+// has run. The calling thread takes part, and while it waits for the last
+// chunks it runs whatever else it can find.
+void zura_parallel_for(int64_t start, int64_t end, body_fn body, void *env) {
+    if (end <= start)
+        return;
+    pthread_once(&started, start_pool);
+    if (threads == 1) {
+        body(start, end, env);
+        return;
+    }
+
+    // Grains small enough that every thread gets several, so a thread that
+    // finishes early still has some to take from the others
+    struct job job = {body, env, (end - start) / (threads * 16), end - start};
+    if (job.grain < 1)
+        job.grain = 1;
+
+    atomic_fetch_add_explicit(&loops, 1, memory_order_release);
+    pthread_mutex_lock(&lock);
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&lock);
+
+    run(&job, start, end);
+    struct task task;
+    while (atomic_load_explicit(&job.left, memory_order_acquire) > 0) {
+        if (find(&task))
+            run(task.job, task.lo, task.hi);
+        else
+            sched_yield();
+    }
+    atomic_fetch_sub_explicit(&loops, 1, memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+// runtime.h
+#ifndef ZURA2_RUNTIME_H
+#define ZURA2_RUNTIME_H
+
+#include <stdint.h>
+
+// Everything libs/ gives the programs zura2 generates. Codegen declares
+// these in every module it builds (Codegen::runtime_fn), and the REPL maps
+// them into its JIT, so a change here has to be made there too. Only
+// pointers, integers and doubles appear in the signatures, which lower the
+// same way in the generated code as they do in C.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// itoa.c and dtoa.c, decimal text of a number at the start of str, not NUL
+// terminated. Returns how many bytes were written.
+int64_t itoa(int64_t value, char *str);
+int64_t dtoa(double value, char *str);
+
+// str.c
+char *zura_str_concat(const char *a, int64_t a_len, const char *b,
+                      int64_t b_len);
+int64_t zura_str_equal(const char *a, int64_t a_len, const char *b,
+                       int64_t b_len);
+int64_t zura_str_compare(const char *a, int64_t a_len, const char *b,
+                         int64_t b_len);
+void *zura_strbuf_new(void);
+void zura_strbuf_append(void *buf, const char *s, int64_t len);
+void zura_strbuf_append_int(void *buf, int64_t value);
+void zura_strbuf_append_float(void *buf, double value);
+const char *zura_strbuf_data(void *buf);
+int64_t zura_strbuf_len(void *buf);
+
+// bounds.c, does not return
+void zura_bounds_fail(int64_t index, int64_t len);
+
+// parallel.c, only in the archive
+void zura_parallel_for(int64_t start, int64_t end,
+                       void (*body)(int64_t lo, int64_t hi, void *env),
+                       void *env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+// str.c
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "runtime.h"
+
+// A str is a pointer and a length, never NUL terminated, so every helper
+// here takes both and none of them scans for the end. They only use
+// pointers and integers in their signatures, which lower the same way in
+// the code zura2 generates as they do in C.
+
+// a followed by b in a new allocation of a_len + b_len bytes. Like every
+// other str it is never freed.
+char *zura_str_concat(const char *a, int64_t a_len, const char *b,
+                      int64_t b_len) {
+    char *out = malloc((size_t)(a_len + b_len) + 1);
+    if (!out)
+        abort();
+    memcpy(out, a, (size_t)a_len);
+    memcpy(out + a_len, b, (size_t)b_len);
+    return out;
+}
+
+// 1 when a and b hold the same bytes. Different lengths never reach memcmp.
+int64_t zura_str_equal(const char *a, int64_t a_len, const char *b,
+                       int64_t b_len) {
+    return a_len == b_len && (a == b || memcmp(a, b, (size_t)a_len) == 0);
+}
+
+// Below, at or above zero as a sorts before, with or after b, byte by byte
+// with the shorter one first when it is a prefix of the other
+int64_t zura_str_compare(const char *a, int64_t a_len, const char *b,
+                         int64_t b_len) {
+    int cmp = memcmp(a, b, (size_t)(a_len < b_len ? a_len : b_len));
+    if (cmp != 0)
+        return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+// A growable buffer behind the strbuf type. Appends double the capacity
+// when it runs out, so n appends copy O(n) bytes in total. A str taken from
+// it points into its data, so a full buffer moves to a new block and leaves
+// the old one as it is, never freed like every other str. Doubling keeps
+// those old blocks smaller than the buffer together.
+struct strbuf {
+    char *data;
+    int64_t len, cap;
+};
+
+void *zura_strbuf_new(void) {
+    struct strbuf *sb = malloc(sizeof(*sb));
+    if (!sb)
+        abort();
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+    return sb;
+}
+
+// Room for n more bytes, returns where they go
+static char *reserve(struct strbuf *sb, int64_t n) {
+    if (sb->len + n > sb->cap) {
+        int64_t cap = sb->cap ? sb->cap * 2 : 64;
+        while (cap < sb->len + n)
+            cap *= 2;
+        char *data = malloc((size_t)cap);
+        if (!data)
+            abort();
+        if (sb->len)
+            memcpy(data, sb->data, (size_t)sb->len);
+        sb->data = data;
+        sb->cap = cap;
+    }
+    return sb->data + sb->len;
+}
+
+void zura_strbuf_append(void *buf, const char *s, int64_t len) {
+    struct strbuf *sb = buf;
+    memcpy(reserve(sb, len), s, (size_t)len);
+    sb->len += len;
+}
+
+// Numbers are formatted straight into the buffer, itoa needs 20 bytes at
+// most and dtoa 24
+void zura_strbuf_append_int(void *buf, int64_t value) {
+    struct strbuf *sb = buf;
+    sb->len += itoa(value, reserve(sb, 24));
+}
+
+void zura_strbuf_append_float(void *buf, double value) {
+    struct strbuf *sb = buf;
+    sb->len += dtoa(value, reserve(sb, 24));
+}
+
+// The contents so far. Appends only ever write past them, so they stay as
+// they are for good.
+const char *zura_strbuf_data(void *buf) { return ((struct strbuf *)buf)->data; }
+
+int64_t zura_strbuf_len(void *buf) { return ((struct strbuf *)buf)->len; }
@@ -3,18 +3,23 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <map>
+#include <ostream>
 
 enum NodeKind {
   symbol_type,
   program,
   number,
   string,
+  array,
   ident,
   binary,
   unary,
   group,
   _call,
+  builtin,
   _index,
+  slice,
+  range,
   assign,
   member,
   dereference,
@@ -26,6 +31,7 @@ enum NodeKind {
   _memcpy,
   prefix,
   module_stmt,
+  use_stmt,
   expr_stmt,
   var_stmt,
   return_stmt,
@@ -38,11 +44,15 @@ enum NodeKind {
   enum_stmt,
 };
 
+struct Encoder;
+
 class Node {
 public:
   struct Expr {
     NodeKind kind;
-    virtual void debug(int indent = 0) const = 0;
+    virtual void debug(std::ostream &out, int indent = 0) const = 0;
+    // Appends a canonical, pointer free encoding of the subtree (encode.cpp)
+    virtual void encode(Encoder &) const = 0;
     virtual llvm::Value *
     codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
             std::map<std::string, llvm::Value *> &) const = 0;
@@ -50,15 +60,23 @@ public:
 
   struct Stmt {
     NodeKind kind;
-    virtual void debug(int indent = 0) const = 0;
+    virtual void debug(std::ostream &out, int indent = 0) const = 0;
+    virtual void encode(Encoder &) const = 0;
     virtual llvm::Value *
     codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
             std::map<std::string, llvm::Value *> &) const = 0;
+    // Emit only what other modules need to reference this stmt (e.g. an
+    // external function prototype). Most stmts have nothing to declare.
+    virtual llvm::Value *declare(llvm::LLVMContext &, llvm::Module &,
+                                 std::map<std::string, llvm::Value *> &) const {
+      return nullptr;
+    }
   };
 
   struct Type {
     NodeKind kind;
-    virtual void debug(int indent = 0) const = 0;
+    virtual void debug(std::ostream &out, int indent = 0) const = 0;
+    virtual void encode(Encoder &) const = 0;
     virtual llvm::Type *codegen(llvm::LLVMContext &) const = 0;
   };
 };
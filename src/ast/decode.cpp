@@ -0,0 +1,246 @@
+#include "decode.hpp"
+
+#include <vector>
+
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+std::uint64_t Decoder::u64() {
+  std::uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (p == end) {
+      ok = false;
+      return 0;
+    }
+    auto byte = static_cast<std::uint8_t>(*p++);
+    v |= std::uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return v;
+  }
+  ok = false;
+  return 0;
+}
+
+std::string Decoder::str() {
+  std::uint64_t size = u64();
+  if (size > std::uint64_t(end - p)) {
+    ok = false;
+    return "";
+  }
+  std::string s(p, size);
+  p += size;
+  return s;
+}
+
+std::uint64_t Decoder::count() {
+  std::uint64_t n = u64();
+  if (n > std::uint64_t(end - p)) {
+    ok = false;
+    return 0;
+  }
+  return n;
+}
+
+bool Decoder::tag(NodeKind &kind) {
+  std::uint64_t t = u64();
+  if (t == 0 || !ok)
+    return false;
+  kind = NodeKind(t - 1);
+  return true;
+}
+
+// Expressions
+
+Node::Expr *Decoder::expr() {
+  NodeKind kind;
+  if (!tag(kind))
+    return nullptr;
+
+  switch (kind) {
+  case NodeKind::number:
+    return arena.emplace<Number>(str());
+  case NodeKind::ident:
+    return arena.emplace<Ident>(str());
+  case NodeKind::string:
+    return arena.emplace<String>(str());
+  case NodeKind::array: {
+    std::vector<Node::Expr *> elems(count());
+    for (auto &elem : elems)
+      elem = expr();
+    return arena.emplace<ArrayLit>(elems);
+  }
+  case NodeKind::binary: {
+    std::string op = str();
+    Node::Expr *left = expr();
+    Node::Expr *right = expr();
+    return arena.emplace<Binary>(left, right, op);
+  }
+  case NodeKind::prefix: {
+    std::string op = str();
+    return arena.emplace<Prefix>(expr(), op);
+  }
+  case NodeKind::unary: {
+    std::string op = str();
+    return arena.emplace<Unary>(expr(), op);
+  }
+  case NodeKind::group:
+    return arena.emplace<Group>(expr());
+  case NodeKind::_call: {
+    Node::Expr *name = expr();
+    std::vector<Node::Expr *> args(count());
+    for (auto &arg : args)
+      arg = expr();
+    return arena.emplace<Call>(name, args);
+  }
+  case NodeKind::builtin: {
+    std::string name = str();
+    std::vector<Node::Expr *> args(count());
+    for (auto &arg : args)
+      arg = expr();
+    return arena.emplace<Builtin>(name, args);
+  }
+  case NodeKind::_index: {
+    Node::Expr *left = expr();
+    return arena.emplace<Index>(left, expr());
+  }
+  case NodeKind::slice: {
+    Node::Expr *left = expr();
+    Node::Expr *start = expr();
+    Node::Expr *end = expr();
+    return arena.emplace<Slice>(left, start, end);
+  }
+  case NodeKind::range: {
+    Node::Expr *start = expr();
+    Node::Expr *end = expr();
+    return arena.emplace<Range>(start, end, u64() != 0);
+  }
+  case NodeKind::assign: {
+    // Positions are not part of the encoding, and nothing after the parser
+    // looks at them
+    Lexer::Token op{};
+    op.value = str();
+    op.kind = Lexer::Kind(u64());
+    Node::Expr *left = expr();
+    Node::Expr *right = expr();
+    return arena.emplace<Assign>(op, left, right);
+  }
+  default:
+    return fail();
+  }
+}
+
+// Statements
+
+Node::Stmt *Decoder::stmt() {
+  NodeKind kind;
+  if (!tag(kind))
+    return nullptr;
+
+  switch (kind) {
+  case NodeKind::program:
+  case NodeKind::block_stmt: {
+    std::vector<Node::Stmt *> stmts(count());
+    for (auto &s : stmts)
+      s = stmt();
+    if (kind == NodeKind::program)
+      return arena.emplace<ProgramStmt>(stmts, arena);
+    return arena.emplace<BlockStmt>(stmts, arena);
+  }
+  case NodeKind::module_stmt:
+    return arena.emplace<ModuleStmt>(str());
+  case NodeKind::use_stmt:
+    return arena.emplace<UseStmt>(str());
+  case NodeKind::fn_stmt: {
+    std::string name = str();
+    bool is_pub = u64() != 0;
+    bool fastmath = u64() != 0;
+    bool unchecked = u64() != 0;
+    Node::Type *return_type = type();
+    std::vector<std::pair<std::string, Node::Type *>> params(count());
+    for (auto &param : params) {
+      param.first = str();
+      param.second = type();
+    }
+    Node::Stmt *block = stmt();
+    auto *fn = arena.emplace<FnStmt>(name, return_type, params, block, arena);
+    fn->is_pub = is_pub;
+    fn->fastmath = fastmath;
+    fn->unchecked = unchecked;
+    return fn;
+  }
+  case NodeKind::enum_stmt: {
+    std::string name = str();
+    bool is_pub = u64() != 0;
+    std::vector<std::string> enums(count());
+    for (auto &e : enums)
+      e = str();
+    auto *en = arena.emplace<EnumStmt>(name, enums, arena);
+    en->is_pub = is_pub;
+    return en;
+  }
+  case NodeKind::expr_stmt:
+    return arena.emplace<ExprStmt>(expr());
+  case NodeKind::var_stmt: {
+    std::string name = str();
+    Node::Type *var_type = type();
+    return arena.emplace<VarStmt>(name, var_type, expr());
+  }
+  case NodeKind::loop_stmt: {
+    bool is_for = u64() != 0;
+    std::string var = str();
+    std::uint64_t unroll = u64();
+    std::uint64_t vectorize = u64();
+    std::uint64_t interleave = u64();
+    bool novectorize = u64() != 0;
+    bool parallel = u64() != 0;
+    std::vector<LoopStmt::Reduction> reductions(count());
+    for (auto &r : reductions) {
+      r.op = str();
+      r.var = str();
+    }
+    Node::Expr *init = expr();
+    Node::Expr *condition = expr();
+    Node::Expr *optional = expr();
+    auto *loop =
+        arena.emplace<LoopStmt>(is_for, init, condition, optional, stmt());
+    loop->var = var;
+    loop->unroll = unroll;
+    loop->vectorize = vectorize;
+    loop->interleave = interleave;
+    loop->novectorize = novectorize;
+    loop->parallel = parallel;
+    loop->reductions = std::move(reductions);
+    return loop;
+  }
+  case NodeKind::print_stmt: {
+    Node::Expr *fd = expr();
+    bool is_ln = u64() != 0;
+    std::vector<Node::Expr *> args(count());
+    for (auto &arg : args)
+      arg = expr();
+    return arena.emplace<PrintStmt>(fd, is_ln, args, arena);
+  }
+  case NodeKind::return_stmt:
+    return arena.emplace<ReturnStmt>(expr());
+  case NodeKind::if_stmt: {
+    Node::Expr *condition = expr();
+    Node::Stmt *block = stmt();
+    return arena.emplace<IfStmt>(condition, block, stmt());
+  }
+  default:
+    return fail();
+  }
+}
+
+// Types
+
+Node::Type *Decoder::type() {
+  NodeKind kind;
+  if (!tag(kind))
+    return nullptr;
+
+  if (kind != NodeKind::symbol_type)
+    return fail();
+  return arena.emplace<SymbolType>(str());
+}
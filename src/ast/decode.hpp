@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../memory/memory.hpp"
+#include "ast.hpp"
+
+/*
+ * Rebuilds nodes from the canonical encoding in encode.hpp
+ *
+ * Nodes are allocated in `arena`. Anything malformed, such as a truncated
+ * buffer or a tag that does not fit where it appears, clears `ok` and
+ * yields null, so a damaged cache file is rejected rather than trusted.
+ */
+
+struct Decoder {
+  const char *p;
+  const char *end;
+  Allocator::ArenaAllocator &arena;
+  bool ok = true;
+
+  Decoder(const char *begin, const char *end,
+          Allocator::ArenaAllocator &arena)
+      : p(begin), end(end), arena(arena) {}
+
+  std::uint64_t u64();
+  std::string str();
+
+  Node::Expr *expr();
+  Node::Stmt *stmt();
+  Node::Type *type();
+
+private:
+  // Reads a tag, false with `kind` unset for "no node"
+  bool tag(NodeKind &kind);
+  // Element counts can never exceed the bytes left, which bounds what a
+  // corrupt count can make us allocate
+  std::uint64_t count();
+  std::nullptr_t fail() {
+    ok = false;
+    return nullptr;
+  }
+};
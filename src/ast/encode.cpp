@@ -0,0 +1,210 @@
+#include "encode.hpp"
+
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "type.hpp"
+
+// Expressions
+
+void Number::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(value);
+}
+
+void Ident::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(ident);
+}
+
+void String::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(value);
+}
+
+void ArrayLit::encode(Encoder &e) const {
+  e.tag(kind);
+  e.u64(elems.size());
+  for (auto *elem : elems)
+    e.node(elem);
+}
+
+void Binary::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(op);
+  e.node(left);
+  e.node(right);
+}
+
+void Prefix::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(op);
+  e.node(left);
+}
+
+void Unary::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(op);
+  e.node(right);
+}
+
+void Group::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(expr);
+}
+
+void Call::encode(Encoder &e) const {
+  if (auto *callee = dynamic_cast<Ident *>(name))
+    e.calls.insert(callee->ident);
+
+  e.tag(kind);
+  e.node(name);
+  e.u64(args.size());
+  for (auto *arg : args)
+    e.node(arg);
+}
+
+void Builtin::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+  e.u64(args.size());
+  for (auto *arg : args)
+    e.node(arg);
+}
+
+void Index::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(left);
+  e.node(index);
+}
+
+void Slice::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(left);
+  e.node(start);
+  e.node(end);
+}
+
+void Range::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(start);
+  e.node(end);
+  e.u64(inclusive);
+}
+
+void Assign::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(op.value);
+  e.u64(op.kind);
+  e.node(left);
+  e.node(right);
+}
+
+// Statements
+
+void ProgramStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.u64(size);
+  for (std::size_t i = 0; i < size; i++)
+    e.node(stmts[i]);
+}
+
+void ModuleStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+}
+
+void UseStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(path);
+}
+
+void FnStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+  e.u64(is_pub);
+  e.u64(fastmath);
+  e.u64(unchecked);
+  e.node(return_type);
+  e.u64(size);
+  for (std::size_t i = 0; i < size; i++) {
+    e.str(args[i]);
+    e.node(args_type[i]);
+  }
+  e.node(block);
+}
+
+void EnumStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+  e.u64(is_pub);
+  e.u64(size);
+  for (std::size_t i = 0; i < size; i++)
+    e.str(enums[i]);
+}
+
+void BlockStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.u64(size);
+  for (std::size_t i = 0; i < size; i++)
+    e.node(stmt[i]);
+}
+
+void ExprStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(expr);
+}
+
+void VarStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+  e.node(type);
+  e.node(expr);
+}
+
+void LoopStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.u64(is_for);
+  e.str(var);
+  e.u64(unroll);
+  e.u64(vectorize);
+  e.u64(interleave);
+  e.u64(novectorize);
+  e.u64(parallel);
+  e.u64(reductions.size());
+  for (const Reduction &r : reductions) {
+    e.str(r.op);
+    e.str(r.var);
+  }
+  e.node(init);
+  e.node(condition);
+  e.node(optional);
+  e.node(block);
+}
+
+void PrintStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(fd);
+  e.u64(is_ln);
+  e.u64(size);
+  for (std::size_t i = 0; i < size; i++)
+    e.node(args[i]);
+}
+
+void ReturnStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(expr);
+}
+
+void IfStmt::encode(Encoder &e) const {
+  e.tag(kind);
+  e.node(condition);
+  e.node(block);
+  e.node(else_block);
+}
+
+// Types
+
+void SymbolType::encode(Encoder &e) const {
+  e.tag(kind);
+  e.str(name);
+}
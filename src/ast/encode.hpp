@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+
+#include "ast.hpp"
+
+/*
+ * Canonical byte encoding of the AST
+ *
+ * Every node writes its kind (+1, so 0 can mean "no node") followed by its
+ * fields in declaration order. Integers are LEB128, strings are length
+ * prefixed. The result has no pointers in it, so equal subtrees always
+ * produce equal bytes and it can be hashed or written to disk as is.
+ */
+
+struct Encoder {
+  std::string out;
+  // Every function name that appears as a call target while encoding
+  std::set<std::string> calls;
+  // Nodes of each NodeKind, when given room for them
+  std::size_t *kinds = nullptr;
+
+  void u64(std::uint64_t v) {
+    do {
+      std::uint8_t byte = v & 0x7f;
+      v >>= 7;
+      out.push_back(static_cast<char>(v ? byte | 0x80 : byte));
+    } while (v);
+  }
+
+  void str(const std::string &s) {
+    u64(s.size());
+    out += s;
+  }
+
+  void tag(NodeKind kind) {
+    if (kinds != nullptr)
+      kinds[kind]++;
+    u64(std::uint64_t(kind) + 1);
+  }
+
+  template <typename T> void node(const T *n) {
+    if (n == nullptr)
+      u64(0);
+    else
+      n->encode(*this);
+  }
+};
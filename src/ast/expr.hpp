@@ -14,13 +14,14 @@ public:
 
   Number(std::string value) : value(value) { kind = NodeKind::number; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Number Node: " << value << std::endl;
+    out << "Number Node: " << value << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Ident : public Node::Expr {
@@ -28,13 +29,14 @@ struct Ident : public Node::Expr {
 
   Ident(std::string ident) : ident(ident) { kind = NodeKind::ident; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Ident Node: " << ident << std::endl;
+    out << "Ident Node: " << ident << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct String : public Node::Expr {
@@ -43,13 +45,36 @@ public:
 
   String(std::string value) : value(value) { kind = NodeKind::string; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "String Node: " << value << std::endl;
+    out << "String Node: " << value << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+};
+
+// `[a, b, c]`
+struct ArrayLit : public Node::Expr {
+public:
+  std::vector<Node::Expr *> elems;
+
+  ArrayLit(std::vector<Node::Expr *> elems) : elems(elems) {
+    kind = NodeKind::array;
+  }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "Array: " << elems.size() << " elements" << std::endl;
+    for (auto elem : elems) {
+      elem->debug(out);
+    }
+  }
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Binary : public Node::Expr {
@@ -63,25 +88,26 @@ public:
     kind = NodeKind::binary;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Binary Node: " << std::endl;
-    std::cout << "     op: " << op << std::endl;
+    out << "Binary Node: " << std::endl;
+    out << "     op: " << op << std::endl;
     if (left == nullptr) {
     } else {
-      std::cout << "   left: \n\t";
-      left->debug();
+      out << "   left: \n\t";
+      left->debug(out);
     }
     if (right == nullptr) {
     } else {
-      std::cout << "  right: \n\t";
-      right->debug();
+      out << "  right: \n\t";
+      right->debug(out);
     }
-    std::cout << std::endl;
+    out << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Prefix : public Node::Expr {
@@ -93,20 +119,21 @@ public:
     kind = NodeKind::prefix;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Prefix Node: " << std::endl;
-    std::cout << "     op: " << op << std::endl;
+    out << "Prefix Node: " << std::endl;
+    out << "     op: " << op << std::endl;
     if (left == nullptr) {
     } else {
-      std::cout << "   left: \n\t";
-      left->debug();
+      out << "   left: \n\t";
+      left->debug(out);
     }
-    std::cout << std::endl;
+    out << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Unary : public Node::Expr {
@@ -118,17 +145,18 @@ public:
     kind = NodeKind::unary;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Unary Node: " << std::endl;
-    std::cout << "      op: " << op << std::endl;
-    std::cout << "   right: ";
-    right->debug();
-    std::cout << std::endl;
+    out << "Unary Node: " << std::endl;
+    out << "      op: " << op << std::endl;
+    out << "   right: ";
+    right->debug(out);
+    out << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Group : public Node::Expr {
@@ -137,15 +165,16 @@ public:
 
   Group(Node::Expr *expr) : expr(expr) { kind = NodeKind::group; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Group: \n\t";
-    expr->debug();
-    std::cout << std::endl;
+    out << "Group: \n\t";
+    expr->debug(out);
+    out << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Call : public Node::Expr {
@@ -158,16 +187,130 @@ public:
     kind = NodeKind::_call;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Call: " << name << std::endl;
+    out << "Call: " << name << std::endl;
     for (auto arg : args) {
-      arg->debug();
+      arg->debug(out);
     }
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+};
+
+// `@name(args)` for the builtins that produce a value, such as @len
+struct Builtin : public Node::Expr {
+public:
+  std::string name;
+  std::vector<Node::Expr *> args;
+
+  Builtin(std::string name, std::vector<Node::Expr *> args)
+      : name(name), args(args) {
+    kind = NodeKind::builtin;
+  }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "Builtin: @" << name << std::endl;
+    for (auto arg : args) {
+      arg->debug(out);
+    }
+  }
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+};
+
+// `left[index]` on an array, a slice or a str
+struct Index : public Node::Expr {
+public:
+  Node::Expr *left;
+  Node::Expr *index;
+
+  Index(Node::Expr *left, Node::Expr *index) : left(left), index(index) {
+    kind = NodeKind::_index;
+  }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "Index: \n";
+    out << "    left: ";
+    left->debug(out);
+    out << "    index: ";
+    index->debug(out);
+  }
+
+  // Where the element is, after the bounds check unless it can be left out.
+  // Sets `elem` to the element type.
+  llvm::Value *address(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &,
+                       llvm::Type *&elem) const;
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+};
+
+// `left[start:end]`, either bound may be left out
+struct Slice : public Node::Expr {
+public:
+  Node::Expr *left;
+  Node::Expr *start;
+  Node::Expr *end;
+
+  Slice(Node::Expr *left, Node::Expr *start, Node::Expr *end)
+      : left(left), start(start), end(end) {
+    kind = NodeKind::slice;
+  }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "Slice: \n";
+    out << "    left: ";
+    left->debug(out);
+    if (start != nullptr) {
+      out << "    start: ";
+      start->debug(out);
+    }
+    if (end != nullptr) {
+      out << "    end: ";
+      end->debug(out);
+    }
+  }
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+};
+
+// `start..end` or `start..=end`, only meaningful as what `loop (i in ...)`
+// walks over
+struct Range : public Node::Expr {
+public:
+  Node::Expr *start;
+  Node::Expr *end;
+  bool inclusive;
+
+  Range(Node::Expr *start, Node::Expr *end, bool inclusive)
+      : start(start), end(end), inclusive(inclusive) {
+    kind = NodeKind::range;
+  }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "Range: " << (inclusive ? "..=" : "..") << "\n";
+    out << "    start: ";
+    start->debug(out);
+    out << "    end: ";
+    end->debug(out);
+  }
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct Assign : public Node::Expr {
@@ -180,20 +323,21 @@ struct Assign : public Node::Expr {
     kind = NodeKind::assign;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "Assign: \n";
-    std::cout << "    op: " << op.value << "\n";
-    std::cout << "    left: ";
+    out << "Assign: \n";
+    out << "    op: " << op.value << "\n";
+    out << "    left: ";
     if (left != nullptr) {
-      left->debug();
+      left->debug(out);
     }
-    std::cout << "    right: ";
+    out << "    right: ";
     if (right != nullptr) {
-      right->debug();
+      right->debug(out);
     }
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include "../memory/memory.hpp"
@@ -22,14 +23,15 @@ public:
     kind = NodeKind::program;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
     for (std::size_t i = 0; i < size; i++)
-      stmts[i]->debug();
+      stmts[i]->debug(out);
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct ModuleStmt : public Node::Stmt {
@@ -38,18 +40,41 @@ public:
 
   ModuleStmt(std::string name) : name(name) { kind = NodeKind::module_stmt; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "MODULE_STMT: " << name << std::endl;
+    out << "MODULE_STMT: " << name << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+  llvm::Value *declare(llvm::LLVMContext &, llvm::Module &,
+                       std::map<std::string, llvm::Value *> &) const override;
+};
+
+// @use name; or @use "path/to/file.zu";
+struct UseStmt : public Node::Stmt {
+public:
+  std::string path; // as written, resolved by the driver
+
+  UseStmt(std::string path) : path(path) { kind = NodeKind::use_stmt; }
+
+  void debug(std::ostream &out, int indent = 0) const override {
+    (void)indent;
+    out << "USE_STMT: " << path << std::endl;
+  }
+
+  llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
+                       std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct FnStmt : public Node::Stmt {
 public:
   std::string name;
+  bool is_pub = false; // visible to modules that @use this one
+  bool fastmath = false; // declared `@fastmath fn`, see FnStmt::codegen
+  bool unchecked = false; // declared `@unchecked fn`, no bounds checks
   Node::Type *return_type;
   Node::Stmt *block;
   // Param vector
@@ -84,53 +109,65 @@ public:
     kind = NodeKind::fn_stmt;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "FN_STMT: \n";
-    std::cout << "   name: " << name << "\n";
-    std::cout << "   type: ";
-    return_type->debug();
-    std::cout << "\n   params: \n";
+    out << "FN_STMT: \n";
+    out << "   name: " << name << "\n";
+    if (fastmath)
+      out << "   @fastmath\n";
+    if (unchecked)
+      out << "   @unchecked\n";
+    out << "   type: ";
+    return_type->debug(out);
+    out << "\n   params: \n";
     if (args != nullptr && args_type != nullptr) {
       for (std::size_t i = 0; i < size; i++) {
-        std::cout << "    {" << args[i] << " ";
-        args_type[i]->debug();
-        std::cout << "}\n";
+        out << "    {" << args[i] << " ";
+        args_type[i]->debug(out);
+        out << "}\n";
       }
     }
-    std::cout << "    body: \n";
-    block->debug(2);
-    std::cout << std::endl;
+    out << "    body: \n";
+    block->debug(out, 2);
+    out << std::endl;
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+  llvm::Value *declare(llvm::LLVMContext &, llvm::Module &,
+                       std::map<std::string, llvm::Value *> &) const override;
 };
 
 struct EnumStmt : public Node::Stmt {
 public:
   std::string name;
+  bool is_pub = false;
   std::string *enums;
   std::size_t size;
 
   EnumStmt(std::string name, const std::vector<std::string> &enums,
            Allocator::ArenaAllocator &arena) : name(name), size(enums.size()) {
     this->enums = static_cast<std::string *>(arena.alloc(size * sizeof(std::string), alignof(std::string)));
-    std::copy(enums.begin(), enums.end(), this->enums);
+    std::uninitialized_copy(enums.begin(), enums.end(), this->enums);
     kind = enum_stmt;
   }
-  void debug(int indent = 0) const override {
+  ~EnumStmt() { std::destroy_n(enums, size); }
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "ENUM_STMT: \n";
-    std::cout << "   name: " << name << "\n";
-    std::cout << "   enums: \n";
+    out << "ENUM_STMT: \n";
+    out << "   name: " << name << "\n";
+    out << "   enums: \n";
     if (enums != nullptr) {
       for (std::size_t i = 0; i < size; i++)
-        std::cout << "     " << enums[i] << "\n";
+        out << "     " << enums[i] << "\n";
     }
   }
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
+  llvm::Value *declare(llvm::LLVMContext &, llvm::Module &,
+                       std::map<std::string, llvm::Value *> &) const override;
 };
 
 struct BlockStmt : public Node::Stmt {
@@ -147,17 +184,18 @@ public:
     kind = block_stmt;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "BLOCK: \n";
+    out << "BLOCK: \n";
     if (stmt != nullptr) {
       for (std::size_t i = 0; i < size; i++)
-        stmt[i]->debug(1);
+        stmt[i]->debug(out, 1);
     }
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct ExprStmt : public Node::Stmt {
@@ -166,14 +204,15 @@ public:
 
   ExprStmt(Node::Expr *expr) : expr(expr) { kind = NodeKind::expr_stmt; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "EXPR_STMT: \n";
-    expr->debug(1);
+    out << "EXPR_STMT: \n";
+    expr->debug(out, 1);
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct VarStmt : public Node::Stmt {
@@ -187,18 +226,19 @@ public:
     kind = var_stmt;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "VAR_STMT: \n";
-    std::cout << "    name: " << name << "\n";
-    std::cout << "    type: ";
-    type->debug();
-    std::cout << "\n    expr: ";
-    expr->debug();
+    out << "VAR_STMT: \n";
+    out << "    name: " << name << "\n";
+    out << "    type: ";
+    type->debug(out);
+    out << "\n    expr: ";
+    expr->debug(out);
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 /* Possable loop variations
@@ -206,10 +246,33 @@ public:
  * loop (i = 0; i < 10) {}
  * loop (i < 10) : (i++) {}
  * loop (i < 10) {}
+ * loop (i in 0..10) {}
+ * loop (i in 0..=9) {}
+ *
+ * Any of them may start with hints for the optimizer, which become the
+ * loop's llvm.loop metadata:
+ * loop @unroll(4) @vectorize(8) @interleave(2) (i in 0..n) {}
+ * loop @novectorize (i < 10) : (i++) {}
+ *
+ * A range loop can also run its iterations on every core, combining what
+ * they add up or pick with reductions:
+ * loop @parallel @reduce(+: total) @reduce(max: top) (i in 0..n) {}
  */
 
 struct LoopStmt : public Node::Stmt {
   bool is_for;
+  std::string var; // `loop (var in range)` when set, the Range is `condition`
+  std::uint64_t unroll = 0;     // @unroll(n), 0 when not given
+  std::uint64_t vectorize = 0;  // @vectorize(width)
+  std::uint64_t interleave = 0; // @interleave(n)
+  bool novectorize = false;     // @novectorize
+  // @reduce(op: var), where op is +, *, min or max
+  struct Reduction {
+    std::string op;
+    std::string var;
+  };
+  bool parallel = false;             // @parallel
+  std::vector<Reduction> reductions; // only on a @parallel loop
   Node::Expr *init;
   Node::Expr *condition;
   Node::Expr *optional;
@@ -222,30 +285,45 @@ struct LoopStmt : public Node::Stmt {
     kind = NodeKind::loop_stmt;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "LOOP_STMT: \n";
-    std::cout << "     is_for: " << is_for << "\n";
+    out << "LOOP_STMT: \n";
+    out << "     is_for: " << is_for << "\n";
+    if (!var.empty())
+      out << "     var: " << var << "\n";
+    if (unroll != 0)
+      out << "     @unroll(" << unroll << ")\n";
+    if (vectorize != 0)
+      out << "     @vectorize(" << vectorize << ")\n";
+    if (interleave != 0)
+      out << "     @interleave(" << interleave << ")\n";
+    if (novectorize)
+      out << "     @novectorize\n";
+    if (parallel)
+      out << "     @parallel\n";
+    for (const Reduction &r : reductions)
+      out << "     @reduce(" << r.op << ": " << r.var << ")\n";
     if (init != nullptr) {
-      std::cout << "     init: ";
-      init->debug(2);
+      out << "     init: ";
+      init->debug(out, 2);
     }
     if (condition != nullptr) {
-      std::cout << "     condition: ";
-      condition->debug(2);
+      out << "     condition: ";
+      condition->debug(out, 2);
     }
     if (optional != nullptr) {
-      std::cout << "     optional: ";
-      optional->debug(2);
+      out << "     optional: ";
+      optional->debug(out, 2);
     }
     if (block != nullptr) {
-      std::cout << "     block: ";
-      block->debug(2);
+      out << "     block: ";
+      block->debug(out, 2);
     }
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct PrintStmt : public Node::Stmt {
@@ -263,22 +341,23 @@ public:
     std::copy(args.begin(), args.end(), this->args);
     kind = NodeKind::print_stmt;
   }
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "PRINT_STMT: \n";
-    std::cout << "   fd: ";
-    fd->debug();
-    std::cout << "\n   is_ln: " << (is_ln ? "true" : "false") << "\n";
-    std::cout << "   args: \n";
+    out << "PRINT_STMT: \n";
+    out << "   fd: ";
+    fd->debug(out);
+    out << "\n   is_ln: " << (is_ln ? "true" : "false") << "\n";
+    out << "   args: \n";
     if (args != nullptr) {
       for (std::size_t i = 0; i < size; i++) {
-        args[i]->debug(2);
+        args[i]->debug(out, 2);
       }
     }
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct ReturnStmt : public Node::Stmt {
@@ -287,17 +366,18 @@ public:
 
   ReturnStmt(Node::Expr *expr) : expr(expr) { kind = return_stmt; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "RETURN_STMT: ";
+    out << "RETURN_STMT: ";
     if (expr != nullptr)
-      expr->debug();
+      expr->debug(out);
     else
-      std::cout << "nullptr\n";
+      out << "nullptr\n";
   }
 
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
 
 struct IfStmt : public Node::Stmt {
@@ -311,18 +391,19 @@ public:
     kind = if_stmt;
   }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "IF_STMT: \n";
-    std::cout << "   condition: ";
-    condition->debug();
-    std::cout << "\n   block: ";
-    block->debug(2);
+    out << "IF_STMT: \n";
+    out << "   condition: ";
+    condition->debug(out);
+    out << "\n   block: ";
+    block->debug(out, 2);
     if (else_block != nullptr) {
-      std::cout << "\n   else block: ";
-      else_block->debug(2);
+      out << "\n   else block: ";
+      else_block->debug(out, 2);
     }
   }
   llvm::Value *codegen(llvm::LLVMContext &, llvm::IRBuilder<> &, llvm::Module &,
                        std::map<std::string, llvm::Value *> &) const override;
+  void encode(Encoder &) const override;
 };
\ No newline at end of file
@@ -11,10 +11,11 @@ public:
 
   SymbolType(std::string name) : name(name) { kind = NodeKind::symbol_type; }
 
-  void debug(int indent = 0) const override {
+  void debug(std::ostream &out, int indent = 0) const override {
     (void)indent;
-    std::cout << "TYPE: " << name;
+    out << "TYPE: " << name;
   }
 
   llvm::Type *codegen(llvm::LLVMContext &ctx) const override;
+  void encode(Encoder &) const override;
 };
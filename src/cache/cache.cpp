@@ -0,0 +1,197 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/raw_ostream.h>
+#include <utime.h>
+
+namespace fs = llvm::sys::fs;
+
+static std::string entry_path(const std::string &dir, const std::string &key,
+                              const std::string &name) {
+  llvm::SmallString<256> path(dir);
+  llvm::sys::path::append(path, key.substr(0, 2), key + "." + name);
+  return std::string(path);
+}
+
+// Makes a temporary file next to `path` so the final rename stays atomic
+static bool temp_for(const std::string &path, std::string &tmp) {
+  if (fs::create_directories(llvm::sys::path::parent_path(path)))
+    return false;
+
+  int fd;
+  llvm::SmallString<256> result;
+  if (fs::createUniqueFile(path + ".tmp-%%%%%%%%", fd, result))
+    return false;
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  tmp = std::string(result);
+  return true;
+}
+
+static bool publish(const std::string &tmp, const std::string &path) {
+  if (fs::rename(tmp, path)) {
+    fs::remove(tmp);
+    return false;
+  }
+  return true;
+}
+
+std::string Cache::directory() {
+  if (const char *dir = std::getenv("ZURA_CACHE_DIR"))
+    return dir;
+
+  llvm::SmallString<256> path;
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME")) {
+    path = xdg;
+  } else if (const char *home = std::getenv("HOME")) {
+    path = home;
+    llvm::sys::path::append(path, ".cache");
+  } else {
+    return "";
+  }
+  llvm::sys::path::append(path, "zura2");
+  return std::string(path);
+}
+
+std::uint64_t Cache::size_limit() {
+  if (const char *size = std::getenv("ZURA_CACHE_SIZE"))
+    return std::strtoull(size, nullptr, 10);
+  return std::uint64_t(1) << 30;
+}
+
+template <typename Parts> static std::string hash_parts(const Parts &parts) {
+  llvm::SHA1 hash;
+  for (llvm::StringRef part : parts) {
+    hash.update(std::to_string(part.size()) + ":");
+    hash.update(part);
+  }
+  return llvm::toHex(hash.final(), true);
+}
+
+std::string Cache::key(const std::vector<std::string> &parts) {
+  return hash_parts(parts);
+}
+
+std::string Cache::key(std::initializer_list<llvm::StringRef> parts) {
+  return hash_parts(parts);
+}
+
+std::string Cache::compiler_id() {
+  static const std::string id = [] {
+    auto exe = llvm::MemoryBuffer::getFile("/proc/self/exe");
+    if (!exe)
+      return std::string("unknown");
+    return key({std::string((*exe)->getBuffer())});
+  }();
+  return id;
+}
+
+bool Cache::lookup(const std::string &dir, const std::string &key,
+                   const std::string &name, const std::string &dest) {
+  std::string path = entry_path(dir, key, name);
+  if (!fs::exists(path) || fs::copy_file(path, dest))
+    return false;
+
+  ::utime(path.c_str(), nullptr); // touch for LRU
+  return true;
+}
+
+bool Cache::store(const std::string &dir, const std::string &key,
+                  const std::string &name, const std::string &src) {
+  std::string path = entry_path(dir, key, name);
+  std::string tmp;
+  if (!temp_for(path, tmp))
+    return false;
+
+  if (fs::copy_file(src, tmp)) {
+    fs::remove(tmp);
+    return false;
+  }
+  return publish(tmp, path);
+}
+
+bool Cache::lookup_text(const std::string &dir, const std::string &key,
+                        const std::string &name, std::string &out) {
+  std::string path = entry_path(dir, key, name);
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return false;
+
+  out = std::string((*buffer)->getBuffer());
+  ::utime(path.c_str(), nullptr);
+  return true;
+}
+
+bool Cache::store_text(const std::string &dir, const std::string &key,
+                       const std::string &name, const std::string &text) {
+  std::string path = entry_path(dir, key, name);
+  std::string tmp;
+  if (!temp_for(path, tmp))
+    return false;
+
+  {
+    std::error_code EC;
+    llvm::raw_fd_ostream out(tmp, EC);
+    if (EC) {
+      fs::remove(tmp);
+      return false;
+    }
+    out << text;
+  }
+  return publish(tmp, path);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> Cache::map(const std::string &dir,
+                                               const std::string &key,
+                                               const std::string &name) {
+  std::string path = entry_path(dir, key, name);
+  // Entries are replaced by rename, never written in place, so the mapping
+  // cannot change under us
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return nullptr;
+
+  ::utime(path.c_str(), nullptr);
+  return std::move(*buffer);
+}
+
+void Cache::evict(const std::string &dir, std::uint64_t max_bytes) {
+  struct Entry {
+    std::string path;
+    std::uint64_t size;
+    llvm::sys::TimePoint<> used;
+  };
+
+  std::vector<Entry> entries;
+  std::uint64_t total = 0;
+  std::error_code EC;
+  for (fs::recursive_directory_iterator it(dir, EC), end; it != end && !EC;
+       it.increment(EC)) {
+    fs::file_status st;
+    if (fs::status(it->path(), st) || st.type() != fs::file_type::regular_file)
+      continue;
+    entries.push_back({it->path(), st.getSize(), st.getLastModificationTime()});
+    total += st.getSize();
+  }
+
+  if (total <= max_bytes)
+    return;
+
+  // Oldest first, and trim to 90% so we do not evict on every store
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  std::uint64_t target = max_bytes / 10 * 9;
+  for (const Entry &e : entries) {
+    if (total <= target)
+      break;
+    if (!fs::remove(e.path))
+      total -= e.size;
+  }
+}
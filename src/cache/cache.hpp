@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <llvm/ADT/StringRef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+/*
+ * Content addressed build cache
+ *
+ * Entries are plain files named after a hex SHA-1 key and sharded by the
+ * first two characters of the key:
+ *
+ *   <dir>/ab/ab01...ef.0.o     object of partition 0
+ *   <dir>/ab/ab01...ef.objs    how many objects the build produced
+ *   <dir>/cd/cd23...01.exe     linked executable
+ *   <dir>/ef/ef45...23.zui     interface of a module, see driver/interface.hpp
+ *
+ * Files are written to a temporary name and renamed into place, so readers
+ * never see half written entries. Hits refresh the mtime, and eviction
+ * removes the least recently used files once the cache is over its limit.
+ */
+
+namespace Cache {
+// $ZURA_CACHE_DIR, $XDG_CACHE_HOME/zura2 or ~/.cache/zura2
+std::string directory();
+
+// $ZURA_CACHE_SIZE in bytes, 1 GiB by default
+std::uint64_t size_limit();
+
+// Hex SHA-1 over every part, each one length prefixed
+std::string key(const std::vector<std::string> &parts);
+// The same without copying the parts, for keys over whole sources
+std::string key(std::initializer_list<llvm::StringRef> parts);
+
+// Hash of the running compiler binary, so rebuilding zura2 invalidates
+std::string compiler_id();
+
+// Copies the entry to `dest` and marks it as recently used
+bool lookup(const std::string &dir, const std::string &key,
+            const std::string &name, const std::string &dest);
+
+// Atomically publishes `src` as an entry
+bool store(const std::string &dir, const std::string &key,
+           const std::string &name, const std::string &src);
+
+// Small text entries such as the object count
+bool lookup_text(const std::string &dir, const std::string &key,
+                 const std::string &name, std::string &out);
+bool store_text(const std::string &dir, const std::string &key,
+                const std::string &name, const std::string &text);
+
+// Maps the entry read only, null when there is none
+std::unique_ptr<llvm::MemoryBuffer> map(const std::string &dir,
+                                        const std::string &key,
+                                        const std::string &name);
+
+// Drops least recently used entries until the cache fits in `max_bytes`
+void evict(const std::string &dir, std::uint64_t max_bytes);
+}; // namespace Cache
@@ -5,7 +5,16 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Target/TargetMachine.h>
 #include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../ast/ast.hpp"
+
+struct ProgramStmt;
 
 class CodegenContext {
 public:
@@ -19,3 +28,165 @@ public:
       : builder(context),
         module(std::make_unique<llvm::Module>(moduleName, context)) {}
 };
+
+namespace Codegen {
+// Where code generation on the calling thread reports errors. That is
+// std::cerr, unless an ErrorSink routes them to the build they belong to.
+std::ostream &err();
+
+// Sends what err() gets on this thread to `out` for as long as it lives
+class ErrorSink {
+public:
+  explicit ErrorSink(std::ostream &out);
+  ~ErrorSink();
+  ErrorSink(const ErrorSink &) = delete;
+  ErrorSink &operator=(const ErrorSink &) = delete;
+
+private:
+  std::ostream *saved;
+};
+
+// Registers the native target with LLVM. Safe to call more than once.
+void init_native_target();
+
+// A TargetMachine for the host. Every thread needs its own.
+std::unique_ptr<llvm::TargetMachine> create_target_machine();
+
+// The calling thread's TargetMachine, created on first use and kept for the
+// life of the thread so long running workers only pay for it once
+llvm::TargetMachine *thread_target_machine();
+
+// With LTO only the part of -O2 meant to run before the link does, the
+// rest runs at the link over the whole program
+enum class Pipeline { per_module, lto_prelink, thin_lto_prelink };
+
+// Runs the -O2 pipeline over the module. A loop hint the optimizer could
+// not honor becomes a warning, with the vectorizer's reason as a note when
+// it gives one. They are appended to `warnings`, or printed to err() when
+// it is null.
+void optimize(llvm::Module &module, llvm::TargetMachine &tm,
+              Pipeline pipeline = Pipeline::per_module,
+              std::string *warnings = nullptr);
+
+// Writes the module as a native object file, returns false on failure
+bool emit_object(llvm::Module &module, llvm::TargetMachine &tm,
+                 const std::string &path);
+
+// Writes the module as LLVM bitcode for link time optimization, with the
+// summary ThinLTO needs when `summary` is set
+bool emit_bitcode(llvm::Module &module, const std::string &path,
+                  bool summary = false);
+
+// Links in the definitions the module uses from the runtime bitcode, made
+// internal so every partition can carry its own copy. Before optimizing,
+// this lets the runtime helpers inline into the code that calls them.
+bool link_runtime(llvm::Module &module, llvm::StringRef bitcode);
+
+// Converts an int to a float or back, or an int to another width, the
+// conversions the language makes without a cast when a value is stored,
+// passed or returned, and an array literal to a slice. Anything else is
+// returned as is.
+llvm::Value *convert(llvm::IRBuilder<> &builder, llvm::Value *value,
+                     llvm::Type *to);
+
+// The value compared against zero, for conditions. A str is true when it
+// is not empty.
+llvm::Value *truthy(llvm::IRBuilder<> &builder, llvm::Value *value,
+                    const llvm::Twine &name);
+
+// A str is { i8*, i64 }, its bytes and how many there are, so the length
+// is always known without looking for a NUL (llvm_str.cpp)
+llvm::StructType *str_type(llvm::LLVMContext &ctx);
+bool is_str(llvm::Type *type);
+llvm::Value *make_str(llvm::IRBuilder<> &builder, llvm::Value *ptr,
+                      llvm::Value *len);
+
+// A pointer to the given bytes in the module's literal pool, which holds
+// one private unnamed_addr constant per distinct string. Asking for the
+// same bytes again returns the same global.
+llvm::Constant *pooled_string(llvm::IRBuilder<> &builder,
+                              llvm::StringRef bytes);
+
+// A constant str of the given bytes, from the pool
+llvm::Constant *str_literal(llvm::IRBuilder<> &builder, llvm::StringRef bytes);
+
+// `a op b` on two strs: + concatenates into a new allocation and the
+// comparisons compare the bytes. Returns nullptr for any other op.
+llvm::Value *str_binary(llvm::IRBuilder<> &builder, const std::string &op,
+                        llvm::Value *a, llvm::Value *b);
+
+// []T is { T*, i64 }, a pointer to the first element and how many there
+// are, which makes str the same type as []char. An array used as a value
+// becomes a slice of itself. (llvm_array.cpp)
+llvm::StructType *slice_type(llvm::Type *elem);
+bool is_slice(llvm::Type *type);
+llvm::Type *slice_elem(llvm::Type *type);
+llvm::Value *make_slice(llvm::IRBuilder<> &builder, llvm::Value *ptr,
+                        llvm::Value *len);
+
+// An alloca in the entry block of the function being built, where the
+// optimizer can promote it and a loop does not grow the stack every time
+// around. Arrays are aligned for vector loads and stores.
+llvm::AllocaInst *entry_alloca(llvm::IRBuilder<> &builder, llvm::Type *type,
+                               const llvm::Twine &name);
+
+// Stores `value` into the `type` at `slot`. An array takes a literal of the
+// same length, a copy of another array or slice, or one value for every
+// element. Prints an error and returns false when the value does not fit.
+bool store(llvm::IRBuilder<> &builder, llvm::Value *slot, llvm::Type *type,
+           llvm::Value *value);
+
+// Stops the program with an error unless 0 <= index < len
+void bounds_check(llvm::IRBuilder<> &builder, llvm::Value *index,
+                  llvm::Value *len);
+
+// An index variable a loop keeps inside [0, bound) in its body, where the
+// bound is the length of `array`, or the constant `limit` when there is no
+// array
+struct InBounds {
+  std::string index;
+  std::string array;
+  std::int64_t limit;
+};
+
+// What the indexing lowered on this thread may skip its bounds check for.
+// FnStmt::codegen sets `unchecked` for an @unchecked function, and
+// LoopStmt::codegen adds what it proves for the length of its body.
+struct BoundsFacts {
+  bool unchecked = false;
+  std::vector<InBounds> loops;
+};
+BoundsFacts &bounds_facts();
+
+// Drops the loop facts added while it lives, also when an exception leaves
+// the loop that added them. Otherwise the facts of a failed build would
+// stay on its thread and skip checks in the next one.
+struct LoopFactsScope {
+  LoopFactsScope() : depth(bounds_facts().loops.size()) {}
+  ~LoopFactsScope() { bounds_facts().loops.resize(depth); }
+  LoopFactsScope(const LoopFactsScope &) = delete;
+  LoopFactsScope &operator=(const LoopFactsScope &) = delete;
+
+  std::size_t depth;
+};
+
+// Declares one of the helpers in libs/ in the module being built, with
+// the signature libs/runtime.h gives it
+llvm::FunctionCallee runtime_fn(llvm::IRBuilder<> &builder,
+                                llvm::StringRef name, llvm::Type *ret,
+                                llvm::ArrayRef<llvm::Type *> params);
+
+// Splits the top level of a program into groups of stmt indices. The split
+// only depends on the program itself, never on how many threads compile it.
+// Partition 0 always holds every stmt that is not a function.
+std::vector<std::vector<std::size_t>>
+partition(const ProgramStmt *program, std::size_t fns_per_partition);
+
+// Lowers the stmts of one partition into cg.module. Everything else in the
+// program, and the pub declarations `imports` of the modules it uses, is
+// only declared so references to them resolve at link.
+bool lower_partition(const ProgramStmt *program,
+                     const std::vector<std::size_t> &stmts,
+                     const std::vector<const Node::Stmt *> &imports,
+                     CodegenContext &cg);
+} // namespace Codegen
@@ -0,0 +1,183 @@
+#include "llvm.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/MDBuilder.h>
+
+llvm::StructType *Codegen::slice_type(llvm::Type *elem) {
+  return llvm::StructType::get(elem->getPointerTo(),
+                               llvm::Type::getInt64Ty(elem->getContext()));
+}
+
+bool Codegen::is_slice(llvm::Type *type) {
+  auto *st = llvm::dyn_cast<llvm::StructType>(type);
+  return st && st->isLiteral() && st->getNumElements() == 2 &&
+         st->getElementType(0)->isPointerTy() &&
+         st->getElementType(1)->isIntegerTy(64);
+}
+
+llvm::Type *Codegen::slice_elem(llvm::Type *type) {
+  return llvm::cast<llvm::StructType>(type)
+      ->getElementType(0)
+      ->getPointerElementType();
+}
+
+llvm::Value *Codegen::make_slice(llvm::IRBuilder<> &builder, llvm::Value *ptr,
+                                 llvm::Value *len) {
+  llvm::Type *elem = ptr->getType()->getPointerElementType();
+  llvm::Value *slice = llvm::UndefValue::get(slice_type(elem));
+  slice = builder.CreateInsertValue(slice, ptr, 0);
+  return builder.CreateInsertValue(slice, len, 1);
+}
+
+llvm::AllocaInst *Codegen::entry_alloca(llvm::IRBuilder<> &builder,
+                                        llvm::Type *type,
+                                        const llvm::Twine &name) {
+  llvm::BasicBlock &entry =
+      builder.GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> at_entry(&entry, entry.begin());
+  llvm::AllocaInst *alloca = at_entry.CreateAlloca(type, nullptr, name);
+  if (type->isArrayTy())
+    alloca->setAlignment(std::max(alloca->getAlign(), llvm::Align(16)));
+  return alloca;
+}
+
+// Sets the `count` scalars of `type` at `ptr` to `value`, with a memset for
+// zero and a loop otherwise, which the optimizer turns into vector stores
+static void fill(llvm::IRBuilder<> &builder, llvm::Value *ptr,
+                 llvm::Type *type, std::uint64_t count, llvm::Value *value) {
+  if (count == 0)
+    return;
+  auto *constant = llvm::dyn_cast<llvm::Constant>(value);
+  if (constant && constant->isNullValue()) {
+    const llvm::DataLayout &dl =
+        builder.GetInsertBlock()->getModule()->getDataLayout();
+    builder.CreateMemSet(ptr, builder.getInt8(0),
+                         count * dl.getTypeAllocSize(type), llvm::MaybeAlign());
+    return;
+  }
+
+  llvm::Function *fn = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *pre = builder.GetInsertBlock();
+  llvm::BasicBlock *body =
+      llvm::BasicBlock::Create(builder.getContext(), "fill.body", fn);
+  llvm::BasicBlock *after =
+      llvm::BasicBlock::Create(builder.getContext(), "fill.after", fn);
+  llvm::Value *first =
+      builder.CreatePointerCast(ptr, type->getPointerTo(), "fill.ptr");
+  builder.CreateBr(body);
+
+  builder.SetInsertPoint(body);
+  llvm::PHINode *i = builder.CreatePHI(builder.getInt64Ty(), 2, "fill.i");
+  i->addIncoming(builder.getInt64(0), pre);
+  builder.CreateStore(value, builder.CreateInBoundsGEP(type, first, i));
+  llvm::Value *next = builder.CreateNUWAdd(i, builder.getInt64(1));
+  i->addIncoming(next, body);
+  builder.CreateCondBr(builder.CreateICmpEQ(next, builder.getInt64(count)),
+                       after, body);
+  builder.SetInsertPoint(after);
+}
+
+bool Codegen::store(llvm::IRBuilder<> &builder, llvm::Value *slot,
+                    llvm::Type *type, llvm::Value *value) {
+  auto *array = llvm::dyn_cast<llvm::ArrayType>(type);
+  if (!array) {
+    builder.CreateStore(convert(builder, value, type), slot);
+    return true;
+  }
+
+  std::uint64_t n = array->getNumElements();
+  llvm::Type *elem = array->getElementType();
+  llvm::Type *from = value->getType();
+
+  // A literal, one element at a time so each is converted on its own
+  if (auto *literal = llvm::dyn_cast<llvm::ArrayType>(from)) {
+    if (literal->getNumElements() != n) {
+      Codegen::err() << "Array literal has " << literal->getNumElements()
+                     << " elements where " << n << " are needed" << std::endl;
+      return false;
+    }
+    for (unsigned i = 0; i < n; i++) {
+      llvm::Value *at = builder.CreateConstInBoundsGEP2_64(type, slot, 0, i);
+      if (!store(builder, at, elem, builder.CreateExtractValue(value, i)))
+        return false;
+    }
+    return true;
+  }
+
+  // Another array, or a slice, is copied. Only as many elements as both
+  // have are, when a slice turns out shorter or longer at run time.
+  if (is_slice(from)) {
+    if (slice_elem(from) != elem) {
+      Codegen::err() << "Cannot copy between arrays of different element types"
+                     << std::endl;
+      return false;
+    }
+    llvm::Value *len = builder.CreateExtractValue(value, 1, "copy.len");
+    if (auto *known = llvm::dyn_cast<llvm::ConstantInt>(len);
+        known && known->getZExtValue() != n) {
+      Codegen::err() << "Cannot copy an array of " << known->getZExtValue()
+                     << " elements into one of " << n << std::endl;
+      return false;
+    }
+    llvm::Value *count = builder.CreateSelect(
+        builder.CreateICmpULT(len, builder.getInt64(n)), len,
+        builder.getInt64(n));
+    const llvm::DataLayout &dl =
+        builder.GetInsertBlock()->getModule()->getDataLayout();
+    llvm::Value *bytes = builder.CreateMul(
+        count, builder.getInt64(dl.getTypeAllocSize(elem)), "copy.bytes");
+    builder.CreateMemMove(slot, llvm::MaybeAlign(),
+                          builder.CreateExtractValue(value, 0, "copy.src"),
+                          llvm::MaybeAlign(), bytes);
+    return true;
+  }
+
+  // One value for every element, through any nesting of arrays
+  if (from->isIntegerTy() || from->isFloatingPointTy()) {
+    llvm::Type *scalar = elem;
+    std::uint64_t count = n;
+    while (auto *inner = llvm::dyn_cast<llvm::ArrayType>(scalar)) {
+      count *= inner->getNumElements();
+      scalar = inner->getElementType();
+    }
+    fill(builder, slot, scalar, count, convert(builder, value, scalar));
+    return true;
+  }
+
+  Codegen::err() << "Cannot store this value in an array" << std::endl;
+  return false;
+}
+
+void Codegen::bounds_check(llvm::IRBuilder<> &builder, llvm::Value *index,
+                           llvm::Value *len) {
+  llvm::LLVMContext &ctx = builder.getContext();
+  llvm::Function *fn = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *ok = llvm::BasicBlock::Create(ctx, "bounds.ok", fn);
+  llvm::BasicBlock *fail = llvm::BasicBlock::Create(ctx, "bounds.fail", fn);
+
+  // Unsigned, so a negative index fails the same compare
+  llvm::Value *in_bounds = builder.CreateICmpULT(index, len, "inbounds");
+  builder.CreateCondBr(in_bounds, ok, fail,
+                       llvm::MDBuilder(ctx).createBranchWeights(1 << 20, 1));
+
+  builder.SetInsertPoint(fail);
+  llvm::FunctionCallee report =
+      runtime_fn(builder, "zura_bounds_fail", builder.getVoidTy(),
+                 {builder.getInt64Ty(), builder.getInt64Ty()});
+  if (auto *decl = llvm::dyn_cast<llvm::Function>(report.getCallee())) {
+    decl->setDoesNotReturn();
+    decl->addFnAttr(llvm::Attribute::Cold);
+  }
+  builder.CreateCall(report, {index, len});
+  builder.CreateUnreachable();
+
+  builder.SetInsertPoint(ok);
+}
+
+Codegen::BoundsFacts &Codegen::bounds_facts() {
+  thread_local BoundsFacts facts;
+  return facts;
+}
@@ -0,0 +1,204 @@
+#include "llvm.hpp"
+
+#include <iostream>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <mutex>
+
+#include "../trace/trace.hpp"
+
+void Codegen::init_native_target() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+}
+
+static std::ostream *&error_stream() {
+  thread_local std::ostream *out = &std::cerr;
+  return out;
+}
+
+std::ostream &Codegen::err() { return *error_stream(); }
+
+Codegen::ErrorSink::ErrorSink(std::ostream &out) : saved(error_stream()) {
+  error_stream() = &out;
+}
+
+Codegen::ErrorSink::~ErrorSink() { error_stream() = saved; }
+
+std::unique_ptr<llvm::TargetMachine> Codegen::create_target_machine() {
+  init_native_target();
+
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+  if (!target) {
+    Codegen::err() << "Could not find target " << triple << ": " << error
+                   << "\n";
+    return nullptr;
+  }
+
+  // Matches what `llc -relocation-model=pic` used to produce
+  llvm::TargetOptions options;
+  return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+      triple, "generic", "", options, llvm::Reloc::PIC_));
+}
+
+llvm::TargetMachine *Codegen::thread_target_machine() {
+  thread_local std::unique_ptr<llvm::TargetMachine> tm =
+      create_target_machine();
+  return tm.get();
+}
+
+// Whether any loop in the module carries a hint from the source, see
+// LoopStmt::codegen
+static bool has_loop_hints(const llvm::Module &module) {
+  for (const llvm::Function &fn : module) {
+    for (const llvm::BasicBlock &bb : fn) {
+      const llvm::Instruction *term = bb.getTerminator();
+      llvm::MDNode *id =
+          term ? term->getMetadata(llvm::LLVMContext::MD_loop) : nullptr;
+      if (!id)
+        continue;
+      for (const llvm::MDOperand &op : id->operands()) {
+        auto *prop = llvm::dyn_cast<llvm::MDNode>(op.get());
+        auto *name = prop && prop->getNumOperands() > 0
+                         ? llvm::dyn_cast<llvm::MDString>(prop->getOperand(0))
+                         : nullptr;
+        if (name && name->getString() != "llvm.loop.mustprogress")
+          return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Collects what the passes say about loop hints they could not honor. The
+// warning comes from the pass that checks for transformations left undone
+// at the end of the pipeline. The vectorizer's analysis of a loop it was
+// told to vectorize is always printed, as its reason. Other remarks only
+// get built because this handler asks for them, and are dropped.
+class HintRemarks : public llvm::DiagnosticHandler {
+public:
+  explicit HintRemarks(std::string &out) : out(out) {}
+
+  bool isAnyRemarkEnabled() const override { return true; }
+
+  bool handleDiagnostics(const llvm::DiagnosticInfo &di) override {
+    auto *opt = llvm::dyn_cast<llvm::DiagnosticInfoIROptimization>(&di);
+    if (!opt)
+      return false;
+    const char *prefix = nullptr;
+    if (di.getKind() == llvm::DK_OptimizationFailure)
+      prefix = "warning: ";
+    else if (llvm::StringRef(opt->getPassName()) ==
+             llvm::OptimizationRemarkAnalysis::AlwaysPrint)
+      prefix = "note: ";
+    if (prefix)
+      out += prefix + opt->getFunction().getName().str() + ": " +
+             opt->getMsg() + "\n";
+    return true;
+  }
+
+private:
+  std::string &out;
+};
+
+void Codegen::optimize(llvm::Module &module, llvm::TargetMachine &tm,
+                       Pipeline pipeline, std::string *warnings) {
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+
+  llvm::PassInstrumentationCallbacks pic;
+  Trace::instrument(pic);
+  llvm::PassBuilder pb(&tm, llvm::PipelineTuningOptions(), llvm::None, &pic);
+  pb.registerModuleAnalyses(mam);
+  pb.registerCGSCCAnalyses(cgam);
+  pb.registerFunctionAnalyses(fam);
+  pb.registerLoopAnalyses(lam);
+  pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+  llvm::ModulePassManager mpm;
+  switch (pipeline) {
+  case Pipeline::per_module:
+    mpm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+    break;
+  case Pipeline::lto_prelink:
+    mpm = pb.buildLTOPreLinkDefaultPipeline(llvm::OptimizationLevel::O2);
+    break;
+  case Pipeline::thin_lto_prelink:
+    mpm = pb.buildThinLTOPreLinkDefaultPipeline(llvm::OptimizationLevel::O2);
+    break;
+  }
+  // Asking for remarks makes every pass build them, so only when a loop
+  // has hints they could be about
+  llvm::LLVMContext &ctx = module.getContext();
+  std::string remarks;
+  std::unique_ptr<llvm::DiagnosticHandler> previous;
+  bool hints = has_loop_hints(module);
+  if (hints) {
+    previous = ctx.getDiagnosticHandler();
+    ctx.setDiagnosticHandler(std::make_unique<HintRemarks>(remarks));
+  }
+
+  mpm.run(module, mam);
+
+  if (hints) {
+    ctx.setDiagnosticHandler(std::move(previous));
+    if (warnings)
+      *warnings += remarks;
+    else
+      Codegen::err() << remarks;
+  }
+}
+
+bool Codegen::emit_object(llvm::Module &module, llvm::TargetMachine &tm,
+                          const std::string &path) {
+  std::error_code EC;
+  llvm::raw_fd_ostream out(path, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    Codegen::err() << "Could not open " << path << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  llvm::legacy::PassManager pm;
+  if (tm.addPassesToEmitFile(pm, out, nullptr, llvm::CGFT_ObjectFile)) {
+    Codegen::err() << "The target can not emit object files\n";
+    return false;
+  }
+  pm.run(module);
+  return true;
+}
+
+bool Codegen::emit_bitcode(llvm::Module &module, const std::string &path,
+                           bool summary) {
+  std::error_code EC;
+  llvm::raw_fd_ostream out(path, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    Codegen::err() << "Could not open " << path << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  if (summary) {
+    llvm::ProfileSummaryInfo psi(module);
+    llvm::ModuleSummaryIndex index =
+        llvm::buildModuleSummaryIndex(module, nullptr, &psi);
+    llvm::WriteBitcodeToFile(module, out, false, &index);
+  } else {
+    llvm::WriteBitcodeToFile(module, out);
+  }
+  return true;
+}
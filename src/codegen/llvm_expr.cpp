@@ -2,11 +2,33 @@
 #include <llvm/IR/Module.h>
 
 #include "../ast/expr.hpp"
+#include "llvm.hpp"
+
+// Whether a variable lives in memory, which all of them do except the
+// variable of a range loop, bound to its value
+static bool is_slot(llvm::Value *binding) {
+  return binding->getType()->isPointerTy();
+}
+
+// What a variable slot holds: an alloca for locals and params, a global, or
+// in the body of a @parallel loop a pointer to a local of the function
+// around it
+static llvm::Type *slot_type(llvm::LLVMContext &ctx, llvm::Value *slot) {
+  if (auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(slot))
+    return alloca->getAllocatedType();
+  if (auto *global = llvm::dyn_cast<llvm::GlobalVariable>(slot))
+    return global->getValueType();
+  if (slot->getType()->isPointerTy())
+    return slot->getType()->getPointerElementType();
+  return llvm::Type::getInt64Ty(ctx);
+}
 
 llvm::Value *
 Number::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                 std::map<std::string, llvm::Value *> &namedValues) const {
   (void)namedValues; // unused
+  if (value.find_first_of(".eE") != std::string::npos)
+    return llvm::ConstantFP::get(llvm::Type::getDoubleTy(ctx), value);
   return llvm::ConstantInt::get(llvm::Type::getInt64Ty(ctx), std::stoll(value));
 }
 
@@ -15,11 +37,23 @@ Ident::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                std::map<std::string, llvm::Value *> &namedValues) const {
   auto it = namedValues.find(ident);
   if (it == namedValues.end()) {
-    std::cerr << "Unknown variable: " << ident << std::endl;
+    Codegen::err() << "Unknown variable: " << ident << std::endl;
     return nullptr;
   }
-  return builder.CreateLoad(llvm::Type::getInt64Ty(ctx), it->second,
-                            ident.c_str());
+  // The variable of a range loop is bound to its value, not to a slot
+  if (!is_slot(it->second))
+    return it->second;
+
+  // An array is used through a slice of all of it, so indexing, slicing and
+  // passing it on never copy the elements
+  llvm::Type *type = slot_type(ctx, it->second);
+  if (auto *array = llvm::dyn_cast<llvm::ArrayType>(type))
+    return Codegen::make_slice(
+        builder,
+        builder.CreateConstInBoundsGEP2_64(array, it->second, 0, 0,
+                                           ident.c_str()),
+        builder.getInt64(array->getNumElements()));
+  return builder.CreateLoad(type, it->second, ident.c_str());
 }
 
 llvm::Value *
@@ -27,8 +61,44 @@ String::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                 std::map<std::string, llvm::Value *> &namedValues) const {
   (void)namedValues;
   (void)ctx;
-  llvm::Value *str = builder.CreateGlobalStringPtr(value);
-  return str;
+  return Codegen::str_literal(builder, value);
+}
+
+llvm::Value *
+ArrayLit::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                  std::map<std::string, llvm::Value *> &namedValues) const {
+  std::vector<llvm::Value *> values;
+  for (auto *elem : elems) {
+    llvm::Value *value = elem->codegen(ctx, builder, namedValues);
+    if (!value)
+      return nullptr;
+    values.push_back(value);
+  }
+
+  // The elements share one type: float if any of them is, the widest int
+  // otherwise. Anything else has to match exactly.
+  llvm::Type *type = values.empty() ? builder.getInt64Ty() : values[0]->getType();
+  for (auto *value : values) {
+    llvm::Type *t = value->getType();
+    if (t == type)
+      continue;
+    if (t->isFloatingPointTy() && type->isIntegerTy())
+      type = t;
+    else if (t->isIntegerTy() && type->isIntegerTy())
+      type = t->getIntegerBitWidth() > type->getIntegerBitWidth() ? t : type;
+    else if (!(t->isIntegerTy() && type->isFloatingPointTy())) {
+      Codegen::err() << "Array elements must all have the same type"
+                     << std::endl;
+      return nullptr;
+    }
+  }
+
+  llvm::Value *array =
+      llvm::UndefValue::get(llvm::ArrayType::get(type, values.size()));
+  for (unsigned i = 0; i < values.size(); i++)
+    array = builder.CreateInsertValue(
+        array, Codegen::convert(builder, values[i], type), i);
+  return array;
 }
 
 llvm::Value *
@@ -40,6 +110,65 @@ Binary::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (!l || !r)
     return nullptr;
 
+  if (Codegen::is_str(l->getType()) || Codegen::is_str(r->getType())) {
+    if (l->getType() != r->getType()) {
+      Codegen::err() << "Operator " << op << " needs a str on both sides"
+                     << std::endl;
+      return nullptr;
+    }
+    if (llvm::Value *result = Codegen::str_binary(builder, op, l, r))
+      return result;
+    Codegen::err() << "Unknown str operator: " << op << std::endl;
+    return nullptr;
+  }
+  if (l->getType()->isAggregateType() || r->getType()->isAggregateType()) {
+    Codegen::err() << "Operator " << op << " needs ints or floats" << std::endl;
+    return nullptr;
+  }
+
+  // Mixed int and float operands are computed in float
+  if (l->getType()->isFloatingPointTy() || r->getType()->isFloatingPointTy()) {
+    llvm::Type *f64 = llvm::Type::getDoubleTy(ctx);
+    l = Codegen::convert(builder, l, f64);
+    r = Codegen::convert(builder, r, f64);
+
+    if (op == "+")
+      return builder.CreateFAdd(l, r, "addtmp");
+    else if (op == "-")
+      return builder.CreateFSub(l, r, "subtmp");
+    else if (op == "*")
+      return builder.CreateFMul(l, r, "multmp");
+    else if (op == "/")
+      return builder.CreateFDiv(l, r, "divtmp");
+    else if (op == "%")
+      return builder.CreateFRem(l, r, "modtmp");
+    else if (op == "==")
+      return builder.CreateFCmpOEQ(l, r, "eqtmp");
+    else if (op == "!=")
+      return builder.CreateFCmpUNE(l, r, "netmp"); // true for NaN
+    else if (op == "<")
+      return builder.CreateFCmpOLT(l, r, "lttmp");
+    else if (op == "<=")
+      return builder.CreateFCmpOLE(l, r, "letmp");
+    else if (op == ">")
+      return builder.CreateFCmpOGT(l, r, "gttmp");
+    else if (op == ">=")
+      return builder.CreateFCmpOGE(l, r, "getmp");
+    Codegen::err() << "Unknown float operator: " << op << std::endl;
+    return nullptr;
+  }
+
+  // Ints of different widths, say a comparison and a number, meet at the
+  // wider one
+  if (l->getType() != r->getType()) {
+    llvm::Type *wide =
+        l->getType()->getIntegerBitWidth() > r->getType()->getIntegerBitWidth()
+            ? l->getType()
+            : r->getType();
+    l = Codegen::convert(builder, l, wide);
+    r = Codegen::convert(builder, r, wide);
+  }
+
   if (op == "+")
     return builder.CreateAdd(l, r, "addtmp");
   else if (op == "-")
@@ -67,7 +196,7 @@ Binary::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   else if (op == "||")
     return builder.CreateOr(l, r, "ortmp");
   else {
-    std::cerr << "Unknown binary operator: " << op << std::endl;
+    Codegen::err() << "Unknown binary operator: " << op << std::endl;
     return nullptr;
   }
 }
@@ -78,7 +207,7 @@ Call::codegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
   // 1. Resolve the function name
   auto *name_expr = dynamic_cast<Ident *>(name);
   if (!name_expr) {
-    std::cerr << "Call target is not a function name\n";
+    Codegen::err() << "Call target is not a function name\n";
     return nullptr;
   }
 
@@ -86,14 +215,14 @@ Call::codegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
   llvm::Function *callee_func =
       builder.GetInsertBlock()->getModule()->getFunction(func_name);
   if (!callee_func) {
-    std::cerr << "Unknown function referenced: " << func_name << "\n";
+    Codegen::err() << "Unknown function referenced: " << func_name << "\n";
     return nullptr;
   }
 
   // 2. Check argument count
   if (callee_func->arg_size() != args.size()) {
-    std::cerr << "Incorrect number of arguments passed to function "
-              << func_name << "\n";
+    Codegen::err() << "Incorrect number of arguments passed to function "
+                   << func_name << "\n";
     return nullptr;
   }
 
@@ -103,13 +232,201 @@ Call::codegen(llvm::LLVMContext &context, llvm::IRBuilder<> &builder,
     llvm::Value *arg_val = arg_expr->codegen(context, builder, named_values);
     if (!arg_val)
       return nullptr;
-    arg_values.push_back(arg_val);
+    arg_values.push_back(Codegen::convert(
+        builder, arg_val,
+        callee_func->getFunctionType()->getParamType(
+            unsigned(arg_values.size()))));
   }
 
   // 4. Emit call instruction
   return builder.CreateCall(callee_func, arg_values, "calltmp");
 }
 
+llvm::Value *
+Builtin::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                 std::map<std::string, llvm::Value *> &namedValues) const {
+  std::vector<llvm::Value *> values;
+  for (auto *arg : args) {
+    llvm::Value *value = arg->codegen(ctx, builder, namedValues);
+    if (!value)
+      return nullptr;
+    values.push_back(value);
+  }
+
+  llvm::Type *i8_ptr = builder.getInt8PtrTy();
+  llvm::Type *i64 = builder.getInt64Ty();
+  auto is_strbuf = [&](std::size_t i) {
+    return i < values.size() && values[i]->getType() == i8_ptr;
+  };
+
+  // @len(s), the length of an array, a slice or a str, or of what a strbuf
+  // holds so far
+  if (name == "len" && values.size() == 1) {
+    if (Codegen::is_slice(values[0]->getType()))
+      return builder.CreateExtractValue(values[0], 1, "len");
+    if (is_strbuf(0))
+      return builder.CreateCall(
+          Codegen::runtime_fn(builder, "zura_strbuf_len", i64, {i8_ptr}),
+          {values[0]}, "len");
+  }
+
+  // @strbuf(), a new empty builder
+  if (name == "strbuf" && values.empty())
+    return builder.CreateCall(
+        Codegen::runtime_fn(builder, "zura_strbuf_new", i8_ptr, {}), {},
+        "strbuf");
+
+  // @append(b, value) adds a str, or an int or a float formatted the way
+  // @output prints it, and evaluates to b
+  if (name == "append" && values.size() == 2 && is_strbuf(0)) {
+    llvm::Value *sb = values[0], *value = values[1];
+    llvm::Type *type = value->getType();
+    if (Codegen::is_str(type)) {
+      builder.CreateCall(Codegen::runtime_fn(builder, "zura_strbuf_append",
+                                             builder.getVoidTy(),
+                                             {i8_ptr, i8_ptr, i64}),
+                         {sb, builder.CreateExtractValue(value, 0),
+                          builder.CreateExtractValue(value, 1)});
+      return sb;
+    }
+    if (type->isFloatingPointTy()) {
+      builder.CreateCall(
+          Codegen::runtime_fn(builder, "zura_strbuf_append_float",
+                              builder.getVoidTy(),
+                              {i8_ptr, builder.getDoubleTy()}),
+          {sb, Codegen::convert(builder, value, builder.getDoubleTy())});
+      return sb;
+    }
+    if (type->isIntegerTy()) {
+      builder.CreateCall(Codegen::runtime_fn(builder, "zura_strbuf_append_int",
+                                             builder.getVoidTy(),
+                                             {i8_ptr, i64}),
+                         {sb, Codegen::convert(builder, value, i64)});
+      return sb;
+    }
+  }
+
+  // @str(b), what b holds as a str without copying it. Later appends to b
+  // never move or overwrite those bytes, see libs/str.c.
+  if (name == "str" && values.size() == 1 && is_strbuf(0)) {
+    llvm::Value *ptr = builder.CreateCall(
+        Codegen::runtime_fn(builder, "zura_strbuf_data", i8_ptr, {i8_ptr}),
+        {values[0]}, "data");
+    llvm::Value *len = builder.CreateCall(
+        Codegen::runtime_fn(builder, "zura_strbuf_len", i64, {i8_ptr}),
+        {values[0]}, "len");
+    return Codegen::make_str(builder, ptr, len);
+  }
+
+  Codegen::err() << "Invalid arguments to @" << name << std::endl;
+  return nullptr;
+}
+
+llvm::Value *
+Slice::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+               std::map<std::string, llvm::Value *> &namedValues) const {
+  llvm::Value *seq = left->codegen(ctx, builder, namedValues);
+  if (!seq)
+    return nullptr;
+  if (!Codegen::is_slice(seq->getType())) {
+    Codegen::err() << "Only arrays, slices and strs can be sliced" << std::endl;
+    return nullptr;
+  }
+
+  llvm::Type *i64 = builder.getInt64Ty();
+  llvm::Value *ptr = builder.CreateExtractValue(seq, 0, "ptr");
+  llvm::Value *len = builder.CreateExtractValue(seq, 1, "len");
+
+  llvm::Value *lo = builder.getInt64(0), *hi = len;
+  if (start && !(lo = start->codegen(ctx, builder, namedValues)))
+    return nullptr;
+  if (end && !(hi = end->codegen(ctx, builder, namedValues)))
+    return nullptr;
+  lo = Codegen::convert(builder, lo, i64);
+  hi = Codegen::convert(builder, hi, i64);
+
+  // Bounds past either end are clamped to it, so a slice is always inside
+  // what it was taken from and never copies
+  auto clamp = [&](llvm::Value *v, llvm::Value *max) {
+    v = builder.CreateSelect(builder.CreateICmpSLT(v, builder.getInt64(0)),
+                             builder.getInt64(0), v);
+    return builder.CreateSelect(builder.CreateICmpSGT(v, max), max, v);
+  };
+  hi = clamp(hi, len);
+  lo = clamp(lo, hi);
+
+  return Codegen::make_slice(
+      builder,
+      builder.CreateInBoundsGEP(Codegen::slice_elem(seq->getType()), ptr, lo,
+                                "slice"),
+      builder.CreateSub(hi, lo, "slice.len"));
+}
+
+// Whether a loop around this index, or an @unchecked on the function, has
+// already shown it is in bounds. `len` is the length of what is indexed.
+static bool proven_in_bounds(const Index &index, llvm::Value *len) {
+  const Codegen::BoundsFacts &facts = Codegen::bounds_facts();
+  if (facts.unchecked)
+    return true;
+  auto *i = dynamic_cast<Ident *>(index.index);
+  if (!i)
+    return false;
+  auto *seq = dynamic_cast<Ident *>(index.left);
+  auto *known = llvm::dyn_cast<llvm::ConstantInt>(len);
+  for (const auto &fact : facts.loops) {
+    if (fact.index != i->ident)
+      continue;
+    if (!fact.array.empty() && seq && seq->ident == fact.array)
+      return true;
+    if (fact.array.empty() && known && known->getSExtValue() >= fact.limit)
+      return true;
+  }
+  return false;
+}
+
+llvm::Value *Index::address(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                            std::map<std::string, llvm::Value *> &namedValues,
+                            llvm::Type *&elem) const {
+  llvm::Value *seq = left->codegen(ctx, builder, namedValues);
+  if (!seq)
+    return nullptr;
+  if (!Codegen::is_slice(seq->getType())) {
+    Codegen::err() << "Only arrays, slices and strs can be indexed"
+                   << std::endl;
+    return nullptr;
+  }
+  llvm::Value *i = index->codegen(ctx, builder, namedValues);
+  if (!i)
+    return nullptr;
+  if (!i->getType()->isIntegerTy()) {
+    Codegen::err() << "An index must be an int" << std::endl;
+    return nullptr;
+  }
+  i = Codegen::convert(builder, i, builder.getInt64Ty());
+
+  llvm::Value *ptr = builder.CreateExtractValue(seq, 0, "ptr");
+  llvm::Value *len = builder.CreateExtractValue(seq, 1, "len");
+  if (!proven_in_bounds(*this, len))
+    Codegen::bounds_check(builder, i, len);
+  elem = Codegen::slice_elem(seq->getType());
+  return builder.CreateInBoundsGEP(elem, ptr, i, "elem");
+}
+
+llvm::Value *
+Index::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+               std::map<std::string, llvm::Value *> &namedValues) const {
+  llvm::Type *elem = nullptr;
+  llvm::Value *at = address(ctx, builder, namedValues, elem);
+  if (!at)
+    return nullptr;
+  // An element that is an array itself decays like a variable does
+  if (auto *array = llvm::dyn_cast<llvm::ArrayType>(elem))
+    return Codegen::make_slice(
+        builder, builder.CreateConstInBoundsGEP2_64(array, at, 0, 0),
+        builder.getInt64(array->getNumElements()));
+  return builder.CreateLoad(elem, at, "load");
+}
+
 llvm::Value *
 Prefix::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                 std::map<std::string, llvm::Value *> &namedValues) const {
@@ -118,21 +435,31 @@ Prefix::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   const std::string &varName = static_cast<Ident *>(left)->ident;
   llvm::Value *ptr = namedValues[varName];
   if (!ptr) {
-    std::cerr << "Undefined variable in prefix expression: " << varName << std::endl;
+    Codegen::err() << "Undefined variable in prefix expression: " << varName
+                   << std::endl;
+    return nullptr;
+  }
+  if (!is_slot(ptr)) {
+    Codegen::err() << "Cannot change the loop variable " << varName
+                   << std::endl;
     return nullptr;
   }
 
   // You must *explicitly* specify the type of the value being loaded
-  llvm::Type *int64Ty = llvm::Type::getInt64Ty(ctx);
-  llvm::Value *val = builder.CreateLoad(int64Ty, ptr, "loadtmp");
+  llvm::Type *type = slot_type(ctx, ptr);
+  llvm::Value *val = builder.CreateLoad(type, ptr, "loadtmp");
 
   llvm::Value *newVal = nullptr;
-  if (op == "++")
-    newVal = builder.CreateAdd(val, llvm::ConstantInt::get(int64Ty, 1), "preincrtmp");
+  if (type->isFloatingPointTy() && (op == "++" || op == "--")) {
+    llvm::Value *one = llvm::ConstantFP::get(type, 1.0);
+    newVal = op == "++" ? builder.CreateFAdd(val, one, "preincrtmp")
+                        : builder.CreateFSub(val, one, "predecrtmp");
+  } else if (op == "++")
+    newVal = builder.CreateAdd(val, llvm::ConstantInt::get(type, 1), "preincrtmp");
   else if (op == "--")
-    newVal = builder.CreateSub(val, llvm::ConstantInt::get(int64Ty, 1), "predecrtmp");
+    newVal = builder.CreateSub(val, llvm::ConstantInt::get(type, 1), "predecrtmp");
   else {
-    std::cerr << "Unknown prefix operator: " << op << std::endl;
+    Codegen::err() << "Unknown prefix operator: " << op << std::endl;
     return nullptr;
   }
 
@@ -148,11 +475,13 @@ Unary::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
     return nullptr;
 
   if (op == "-")
-    return builder.CreateNeg(val, "negtmp");
+    return val->getType()->isFloatingPointTy()
+               ? builder.CreateFNeg(val, "negtmp")
+               : builder.CreateNeg(val, "negtmp");
   else if (op == "+")
     return val; // no-op
   else {
-    std::cerr << "Unknown unary operator: " << op << std::endl;
+    Codegen::err() << "Unknown unary operator: " << op << std::endl;
     return nullptr;
   }
 }
@@ -163,8 +492,50 @@ Group::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   return expr->codegen(ctx, builder, namedValues);
 }
 
+llvm::Value *
+Range::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+               std::map<std::string, llvm::Value *> &namedValues) const {
+  (void)ctx;
+  (void)builder;
+  (void)namedValues;
+  Codegen::err() << "A range is only something to loop over, loop (i in a..b)"
+                 << std::endl;
+  return nullptr;
+}
+
 llvm::Value *
 Assign::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                 std::map<std::string, llvm::Value *> &namedValues) const {
-  return nullptr; // TODO: Do this at a later date
+  llvm::Value *slot = nullptr;
+  llvm::Type *type = nullptr;
+  if (auto *element = dynamic_cast<Index *>(left)) {
+    if (!(slot = element->address(ctx, builder, namedValues, type)))
+      return nullptr;
+  } else if (auto *target = dynamic_cast<Ident *>(left)) {
+    auto it = namedValues.find(target->ident);
+    if (it == namedValues.end()) {
+      Codegen::err() << "Unknown variable: " << target->ident << std::endl;
+      return nullptr;
+    }
+    slot = it->second;
+    if (!is_slot(slot)) {
+      Codegen::err() << "Cannot change the loop variable " << target->ident
+                     << std::endl;
+      return nullptr;
+    }
+    type = slot_type(ctx, slot);
+  } else {
+    Codegen::err() << "Can only assign to a variable or an element"
+                   << std::endl;
+    return nullptr;
+  }
+
+  llvm::Value *val = right->codegen(ctx, builder, namedValues);
+  if (!val)
+    return nullptr;
+  if (type->isArrayTy())
+    return Codegen::store(builder, slot, type, val) ? val : nullptr;
+  val = Codegen::convert(builder, val, type);
+  builder.CreateStore(val, slot);
+  return val;
 }
@@ -0,0 +1,71 @@
+#include "llvm.hpp"
+
+#include <iostream>
+#include <llvm/Support/raw_ostream.h>
+
+#include "../ast/stmt.hpp"
+#include "../trace/trace.hpp"
+
+std::vector<std::vector<std::size_t>>
+Codegen::partition(const ProgramStmt *program,
+                   std::size_t fns_per_partition) {
+  std::vector<std::vector<std::size_t>> parts(1);
+  std::size_t in_current = 0;
+
+  for (std::size_t i = 0; i < program->size; ++i) {
+    if (program->stmts[i]->kind != NodeKind::fn_stmt) {
+      parts[0].push_back(i);
+      continue;
+    }
+    if (in_current == fns_per_partition) {
+      parts.emplace_back();
+      in_current = 0;
+    }
+    parts.back().push_back(i);
+    in_current++;
+  }
+
+  return parts;
+}
+
+bool Codegen::lower_partition(const ProgramStmt *program,
+                              const std::vector<std::size_t> &stmts,
+                              const std::vector<const Node::Stmt *> &imports,
+                              CodegenContext &cg) {
+  std::vector<bool> owned(program->size, false);
+  for (std::size_t i : stmts)
+    owned[i] = true;
+
+  for (const Node::Stmt *stmt : imports)
+    stmt->declare(cg.context, *cg.module, cg.namedValues);
+
+  // Declarations first, in source order, so every partition sees the same
+  // prototypes no matter where the definitions ended up.
+  for (std::size_t i = 0; i < program->size; ++i) {
+    Node::Stmt *stmt = program->stmts[i];
+    if (owned[i] && stmt->kind != NodeKind::fn_stmt) {
+      if (!stmt->codegen(cg.context, cg.builder, *cg.module, cg.namedValues))
+        return false;
+    } else {
+      stmt->declare(cg.context, *cg.module, cg.namedValues);
+    }
+  }
+
+  for (std::size_t i : stmts) {
+    Node::Stmt *stmt = program->stmts[i];
+    if (stmt->kind != NodeKind::fn_stmt)
+      continue;
+    Trace::Scope scope(Trace::Kind::function,
+                       static_cast<FnStmt *>(stmt)->name);
+    if (!stmt->codegen(cg.context, cg.builder, *cg.module, cg.namedValues))
+      return false;
+  }
+
+  std::string err;
+  llvm::raw_string_ostream err_stream(err);
+  if (llvm::verifyModule(*cg.module, &err_stream)) {
+    Codegen::err() << "Invalid code generated:\n" << err_stream.str();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,42 @@
+#include "llvm.hpp"
+
+#include <iostream>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+bool Codegen::link_runtime(llvm::Module &module, llvm::StringRef bitcode) {
+  auto runtime = llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef(bitcode, "runtime.bc"), module.getContext());
+  if (!runtime) {
+    Codegen::err() << "Could not read the runtime bitcode: "
+                   << llvm::toString(runtime.takeError()) << "\n";
+    return false;
+  }
+
+  // The runtime was compiled for the same host by clang, which pins the CPU
+  // and its features on every function. Code lowered here carries none, and
+  // the inliner will not inline a callee that asks for more than its caller.
+  for (llvm::Function &fn : **runtime) {
+    fn.removeFnAttr("target-cpu");
+    fn.removeFnAttr("target-features");
+    fn.removeFnAttr("tune-cpu");
+  }
+  (*runtime)->setTargetTriple(module.getTargetTriple());
+  (*runtime)->setDataLayout(module.getDataLayout());
+
+  // Only what the module calls is linked, everything it brings in becomes
+  // internal so partitions linked together do not clash
+  bool failed = llvm::Linker::linkModules(
+      module, std::move(*runtime), llvm::Linker::LinkOnlyNeeded,
+      [](llvm::Module &linked, const llvm::StringSet<> &added) {
+        llvm::internalizeModule(linked, [&](const llvm::GlobalValue &gv) {
+          return !gv.hasName() || added.count(gv.getName()) == 0;
+        });
+      });
+  if (failed)
+    Codegen::err() << "Could not link the runtime bitcode\n";
+  return !failed;
+}
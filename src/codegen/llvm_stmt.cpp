@@ -1,13 +1,26 @@
+#include "../ast/expr.hpp"
 #include "../ast/stmt.hpp"
+#include "llvm.hpp"
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Value.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/SaveAndRestore.h>
+#include <functional>
+#include <optional>
+#include <set>
 
 llvm::Value *
 ProgramStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                      llvm::Module &module,
                      std::map<std::string, llvm::Value *> &namedValues) const {
+  // Declare every function up front so calls can refer to later ones
+  for (std::size_t i = 0; i < size; ++i) {
+    if (stmts[i]->kind == NodeKind::fn_stmt)
+      stmts[i]->declare(ctx, module, namedValues);
+  }
+
   for (std::size_t i = 0; i < size; ++i) {
     if (!stmts[i]->codegen(ctx, builder, module, namedValues))
       return nullptr;
@@ -20,10 +33,26 @@ llvm::Value *
 ModuleStmt ::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                      llvm::Module &module,
                      std::map<std::string, llvm::Value *> &namedValues) const {
-  (void)ctx;
+  (void)builder;
+  return declare(ctx, module, namedValues);
+}
+
+// Modules are resolved and linked by the driver, nothing to emit here
+llvm::Value *
+UseStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                 llvm::Module &module,
+                 std::map<std::string, llvm::Value *> &namedValues) const {
   (void)builder;
   (void)module;
   (void)namedValues;
+  return llvm::Constant::getNullValue(
+      llvm::Type::getInt64Ty(ctx)); // dummy return
+}
+
+llvm::Value *
+ModuleStmt::declare(llvm::LLVMContext &ctx, llvm::Module &module,
+                    std::map<std::string, llvm::Value *> &namedValues) const {
+  (void)namedValues;
 
   module.setModuleIdentifier(name);
 
@@ -32,20 +61,55 @@ ModuleStmt ::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
 }
 
 llvm::Value *
-FnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
-                llvm::Module &module,
-                std::map<std::string, llvm::Value *> &locals) const {
+FnStmt::declare(llvm::LLVMContext &ctx, llvm::Module &module,
+                std::map<std::string, llvm::Value *> &namedValues) const {
+  (void)namedValues;
   llvm::Type *ret_type = return_type->codegen(ctx);
 
   std::vector<llvm::Type *> param_types;
   for (size_t i = 0; i < size; ++i)
     param_types.push_back(args_type[i]->codegen(ctx));
 
+  // Arrays are values, copying one in or out of every call is never what
+  // was meant
+  bool array = ret_type->isArrayTy();
+  for (llvm::Type *type : param_types)
+    array = array || type->isArrayTy();
+  if (array) {
+    Codegen::err() << "Pass arrays to and from " << name << " as slices ([]T)"
+                   << std::endl;
+    return nullptr;
+  }
+
   llvm::FunctionType *fn_type =
       llvm::FunctionType::get(ret_type, param_types, false);
 
-  llvm::Function *fn = llvm::Function::Create(
-      fn_type, llvm::Function::ExternalLinkage, name, module);
+  if (llvm::Function *fn = module.getFunction(name)) {
+    if (fn->getFunctionType() != fn_type) {
+      Codegen::err() << "Conflicting declarations of function: " << name
+                     << std::endl;
+      return nullptr;
+    }
+    return fn;
+  }
+
+  return llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage,
+                                name, module);
+}
+
+llvm::Value *
+FnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                llvm::Module &module,
+                std::map<std::string, llvm::Value *> &locals) const {
+  // Reuse a forward declaration of this function if one was emitted already
+  auto *fn = llvm::cast_or_null<llvm::Function>(declare(ctx, module, locals));
+  if (!fn)
+    return nullptr;
+  if (!fn->isDeclaration()) {
+    Codegen::err() << "Redefinition of function: " << name << std::endl;
+    return nullptr;
+  }
+  llvm::Type *ret_type = fn->getReturnType();
 
   // Create new entry block
   llvm::BasicBlock *entry = llvm::BasicBlock::Create(ctx, "entry", fn);
@@ -64,8 +128,27 @@ FnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
     idx++;
   }
 
-  // Emit function body
-  block->codegen(ctx, builder, module, locals);
+  // Every float operation in the body may be reassociated and contracted,
+  // which is what lets float reductions vectorize
+  llvm::IRBuilderBase::FastMathFlagGuard fmf_guard(builder);
+  if (fastmath) {
+    llvm::FastMathFlags fmf;
+    fmf.setFast();
+    builder.setFastMathFlags(fmf);
+    for (const char *attr : {"unsafe-fp-math", "no-infs-fp-math",
+                             "no-nans-fp-math", "no-signed-zeros-fp-math",
+                             "approx-func-fp-math"})
+      fn->addFnAttr(attr, "true");
+  }
+
+  // Emit function body. Indexing in an @unchecked body trusts every index
+  // it is given, and the guard puts that back even when an exception leaves
+  // the body.
+  {
+    llvm::SaveAndRestore<bool> guard(Codegen::bounds_facts().unchecked,
+                                     unchecked);
+    block->codegen(ctx, builder, module, locals);
+  }
 
   // If no return statement, emit default return (void or 0)
   if (!builder.GetInsertBlock()->getTerminator()) {
@@ -78,63 +161,67 @@ FnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   return fn;
 }
 
+llvm::Value *
+EnumStmt::declare(llvm::LLVMContext &ctx, llvm::Module &module,
+                  std::map<std::string, llvm::Value *> &namedValues) const {
+  llvm::StructType *enum_type = llvm::StructType::getTypeByName(ctx, name);
+  if (!enum_type) {
+    std::vector<llvm::Type *> enum_types;
+    for (size_t i = 0; i < size; ++i) {
+      enum_types.push_back(llvm::Type::getInt32Ty(ctx));
+    }
+    enum_type = llvm::StructType::create(ctx, enum_types, name);
+  }
+
+  llvm::GlobalVariable *enum_var = module.getNamedGlobal(name);
+  if (!enum_var) {
+    enum_var = new llvm::GlobalVariable(module, enum_type, false,
+                                        llvm::GlobalValue::ExternalLinkage,
+                                        nullptr, name);
+    enum_var->setAlignment(llvm::Align(4));
+  }
+
+  namedValues[name] = enum_var;
+  return enum_var;
+}
+
 llvm::Value *
 EnumStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                   llvm::Module &module,
                   std::map<std::string, llvm::Value *> &namedValues) const {
-  (void)ctx;
   (void)builder;
-  (void)module;
-  (void)namedValues;
-  std::vector<llvm::Type *> enum_types;
-  for (size_t i = 0; i < size; ++i) {
-    enum_types.push_back(llvm::Type::getInt32Ty(ctx));
+  auto *enum_var = llvm::cast<llvm::GlobalVariable>(
+      declare(ctx, module, namedValues));
+  if (!enum_var->isDeclaration()) {
+    Codegen::err() << "Redefinition of enum: " << name << std::endl;
+    return nullptr;
   }
 
-  llvm::StructType *enum_type = llvm::StructType::create(ctx, enum_types, name);
-
   std::vector<llvm::Constant *> enum_values;
   for (size_t i = 0; i < size; ++i) {
     enum_values.push_back(llvm::ConstantInt::get(llvm::Type::getInt32Ty(ctx), i));
   }
 
-  llvm::Constant *initializer = llvm::ConstantStruct::get(enum_type, enum_values);
-
-  llvm::GlobalVariable *enum_var = new llvm::GlobalVariable(
-      module, enum_type, false, llvm::GlobalValue::ExternalLinkage,
-      initializer, name);
-
-  enum_var->setAlignment(llvm::Align(4));
-  namedValues[name] = enum_var;
+  auto *enum_type = llvm::cast<llvm::StructType>(enum_var->getValueType());
+  enum_var->setInitializer(llvm::ConstantStruct::get(enum_type, enum_values));
   return enum_var;
 }
 
-static std::string interpretEscapes(const std::string &s) {
-  std::string out;
-  for (size_t i = 0; i < s.length(); ++i) {
-    if (s[i] == '\\' && i + 1 < s.length()) {
-      switch (s[++i]) {
-      case 'n':
-        out += '\n';
-        break;
-      case 't':
-        out += '\t';
-        break;
-      case '\\':
-        out += '\\';
-        break;
-      case '"':
-        out += '"';
-        break;
-      default:
-        out += s[i];
-        break;
-      }
-    } else {
-      out += s[i];
-    }
+// The buffer numbers are formatted into, one per function, big enough for
+// itoa and dtoa. It lives in the entry block so a print inside a loop does
+// not grow the stack on every iteration.
+static llvm::Value *print_buffer(llvm::LLVMContext &ctx,
+                                 llvm::IRBuilder<> &builder) {
+  llvm::BasicBlock &entry = builder.GetInsertBlock()->getParent()->getEntryBlock();
+  for (llvm::Instruction &inst : entry) {
+    if (inst.getName() == "print.buf")
+      return &inst;
   }
-  return out;
+
+  llvm::IRBuilder<> at_entry(&entry, entry.begin());
+  return at_entry.CreateAlloca(
+      llvm::ArrayType::get(llvm::Type::getInt8Ty(ctx), 32), nullptr,
+      "print.buf");
 }
 
 llvm::Value *
@@ -145,26 +232,20 @@ PrintStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (!fd_val)
     return nullptr;
 
-  llvm::Function *itoa_fn = module.getFunction("itoa");
-  if (!itoa_fn) {
-    auto *i64Ty = llvm::Type::getInt64Ty(ctx);
-    auto *i8PtrTy = llvm::Type::getInt8Ty(ctx)->getPointerTo();
-    llvm::FunctionType *itoaType =
-        llvm::FunctionType::get(i8PtrTy, {i64Ty, i8PtrTy}, false);
-    itoa_fn = llvm::Function::Create(itoaType, llvm::Function::ExternalLinkage,
-                                     "itoa", module);
-  }
-
-  llvm::Function *strlen_fn = module.getFunction("strlen");
-  if (!strlen_fn) {
-    auto *i8PtrTy = llvm::Type::getInt8Ty(ctx)->getPointerTo();
-    llvm::FunctionType *strlenType =
-        llvm::FunctionType::get(llvm::Type::getInt64Ty(ctx), {i8PtrTy}, false);
-    strlen_fn = llvm::Function::Create(
-        strlenType, llvm::Function::ExternalLinkage, "strlen", module);
-  }
+  // write() takes an int fd
+  if (fd_val->getType()->getIntegerBitWidth() != 32)
+    fd_val = builder.CreateTrunc(fd_val, llvm::Type::getInt32Ty(ctx));
 
-  std::string final_str;
+  // itoa in libs/itoa.c and dtoa in libs/dtoa.c write to the start of the
+  // buffer and return how many bytes they wrote
+  auto *i64Ty = llvm::Type::getInt64Ty(ctx);
+  auto *i8PtrTy = llvm::Type::getInt8Ty(ctx)->getPointerTo();
+  llvm::FunctionCallee itoa_fn = module.getOrInsertFunction(
+      "itoa", llvm::FunctionType::get(i64Ty, {i64Ty, i8PtrTy}, false));
+  llvm::FunctionCallee dtoa_fn = module.getOrInsertFunction(
+      "dtoa", llvm::FunctionType::get(i64Ty, {llvm::Type::getDoubleTy(ctx),
+                                              i8PtrTy},
+                                      false));
 
   llvm::Function *write_fn = module.getFunction("write");
   if (!write_fn) {
@@ -178,6 +259,8 @@ PrintStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
         write_type, llvm::Function::ExternalLinkage, "write", module);
   }
 
+  // What the statement evaluates to, the result of its last write
+  llvm::Value *last = llvm::Constant::getNullValue(llvm::Type::getInt64Ty(ctx));
   for (size_t i = 0; i < size; ++i) {
     llvm::Value *arg_val = args[i]->codegen(ctx, builder, namedValues);
     if (!arg_val)
@@ -187,30 +270,31 @@ PrintStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
     llvm::Value *strPtr = nullptr;
     llvm::Value *strLen = nullptr;
 
-    // Case 1: Constant string (global)
-    if (auto *global = llvm::dyn_cast<llvm::GlobalVariable>(arg_val)) {
-      if (auto *data = llvm::dyn_cast<llvm::ConstantDataArray>(
-              global->getInitializer())) {
-        std::string interpreted = interpretEscapes(data->getAsCString().str());
-
-        // Remove quotes if present
-        if (interpreted.size() >= 2 && interpreted.front() == '"' &&
-            interpreted.back() == '"') {
-          interpreted = interpreted.substr(1, interpreted.size() - 2);
-        }
+    // Case 1: str, which already knows its length
+    if (Codegen::is_str(argType)) {
+      strPtr = builder.CreateExtractValue(arg_val, 0, "str.ptr");
+      strLen = builder.CreateExtractValue(arg_val, 1, "str.len");
+    }
 
-        strPtr = builder.CreateGlobalStringPtr(interpreted);
-        strLen = builder.getInt64(interpreted.size());
-      }
+    // Case 2: Float
+    if (!strPtr && argType->isFloatingPointTy()) {
+      strPtr = builder.CreatePointerCast(print_buffer(ctx, builder), i8PtrTy);
+      strLen = builder.CreateCall(
+          dtoa_fn, {Codegen::convert(builder, arg_val,
+                                     llvm::Type::getDoubleTy(ctx)),
+                    strPtr});
     }
 
-    // Case 2: Integer or non-string value (e.g., variable like i)
+    // Case 3: Integer or non-string value (e.g., variable like i)
     if (!strPtr) {
-      // Allocate buffer for itoa
-      llvm::Value *buf =
-          builder.CreateAlloca(llvm::ArrayType::get(builder.getInt8Ty(), 21));
-      llvm::Value *bufPtr =
-          builder.CreatePointerCast(buf, llvm::Type::getInt8Ty(ctx)->getPointerTo());
+      if (!argType->isIntegerTy()) {
+        Codegen::err() << "Only ints, floats and strs can be printed, a strbuf "
+                     "needs @str first"
+                  << std::endl;
+        return nullptr;
+      }
+      strPtr = builder.CreatePointerCast(
+          print_buffer(ctx, builder), llvm::Type::getInt8Ty(ctx)->getPointerTo());
 
       // Convert value to i64 if needed
       if (!arg_val->getType()->isIntegerTy(64)) {
@@ -218,32 +302,25 @@ PrintStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
             builder.CreateIntCast(arg_val, llvm::Type::getInt64Ty(ctx), true);
       }
 
-      strPtr = builder.CreateCall(itoa_fn, {arg_val, bufPtr});
-      strLen = builder.CreateCall(strlen_fn, {strPtr});
+      strLen = builder.CreateCall(itoa_fn, {arg_val, strPtr});
     }
 
     // Emit write(fd, strPtr, strLen)
-    builder.CreateCall(write_fn, {fd_val, strPtr, strLen});
+    last = builder.CreateCall(write_fn, {fd_val, strPtr, strLen});
 
     // Optional space between arguments
     if (i + 1 < size) {
-      llvm::Value *spaceStr = builder.CreateGlobalStringPtr(" ");
+      llvm::Value *spaceStr = Codegen::pooled_string(builder, " ");
       builder.CreateCall(write_fn, {fd_val, spaceStr, builder.getInt64(1)});
     }
   }
 
   if (is_ln) {
-    llvm::Value *newline = builder.CreateGlobalStringPtr("\n");
-    builder.CreateCall(write_fn, {fd_val, newline, builder.getInt64(1)});
+    llvm::Value *newline = Codegen::pooled_string(builder, "\n");
+    last = builder.CreateCall(write_fn, {fd_val, newline, builder.getInt64(1)});
   }
 
-  llvm::Value *str_ptr = builder.CreateGlobalStringPtr(final_str);
-  llvm::Value *len_val = builder.getInt64(final_str.size());
-
-  if (fd_val->getType()->getIntegerBitWidth() != 32)
-    fd_val = builder.CreateTrunc(fd_val, llvm::Type::getInt32Ty(ctx));
-
-  return builder.CreateCall(write_fn, {fd_val, str_ptr, len_val});
+  return last;
 }
 
 llvm::Value *
@@ -275,19 +352,28 @@ VarStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (!initVal)
     return nullptr;
 
-  llvm::AllocaInst *alloca =
-      builder.CreateAlloca(type->codegen(ctx), nullptr, name);
-  builder.CreateStore(initVal, alloca);
+  llvm::Type *var_type = type->codegen(ctx);
+  llvm::AllocaInst *alloca = Codegen::entry_alloca(builder, var_type, name);
+  if (!Codegen::store(builder, alloca, var_type, initVal))
+    return nullptr;
   namedValues[name] = alloca;
 
   return alloca;
 }
 
+// Set while the body of a @parallel loop is lowered into a function of its
+// own, which a return cannot leave
+static thread_local bool in_parallel_body = false;
+
 llvm::Value *
 ReturnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                     llvm::Module &module,
                     std::map<std::string, llvm::Value *> &namedValues) const {
   (void)module;
+  if (in_parallel_body) {
+    Codegen::err() << "Cannot return from inside a @parallel loop" << std::endl;
+    return nullptr;
+  }
   if (!expr) {
     builder.CreateRetVoid();
     return nullptr;
@@ -297,14 +383,589 @@ ReturnStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (!retVal)
     return nullptr;
 
+  retVal = Codegen::convert(
+      builder, retVal, builder.GetInsertBlock()->getParent()->getReturnType());
   builder.CreateRet(retVal);
   return retVal;
 }
 
+// How a stmt or expr uses a variable it names
+enum class Use { read, write, declare };
+using See = std::function<void(const std::string &, Use)>;
+
+// Calls `see` for every variable `node` names: assigning to one or stepping
+// it writes it, and a var stmt or range loop declares it. Writing to an
+// element of an array only reads the array. Returns false when `node` holds
+// something not known here, which might do anything.
+static bool names(const Node::Expr *node, const See &see);
+static bool names(const Node::Stmt *node, const See &see);
+
+static bool is_ident(const Node::Expr *node, const std::string &name) {
+  return node && node->kind == NodeKind::ident &&
+         static_cast<const Ident *>(node)->ident == name;
+}
+
+// The target of an assignment or a step, written when it is a variable
+static bool target(const Node::Expr *node, const See &see) {
+  if (node && node->kind == NodeKind::ident) {
+    see(static_cast<const Ident *>(node)->ident, Use::write);
+    return true;
+  }
+  return names(node, see);
+}
+
+static bool names(const Node::Expr *node, const See &see) {
+  if (!node)
+    return true;
+  switch (node->kind) {
+  case NodeKind::number:
+  case NodeKind::string:
+    return true;
+  case NodeKind::ident:
+    see(static_cast<const Ident *>(node)->ident, Use::read);
+    return true;
+  case NodeKind::assign: {
+    auto *assign = static_cast<const Assign *>(node);
+    return target(assign->left, see) && names(assign->right, see);
+  }
+  case NodeKind::prefix:
+    return target(static_cast<const Prefix *>(node)->left, see);
+  case NodeKind::binary: {
+    auto *binary = static_cast<const Binary *>(node);
+    return names(binary->left, see) && names(binary->right, see);
+  }
+  case NodeKind::unary:
+    return names(static_cast<const Unary *>(node)->right, see);
+  case NodeKind::group:
+    return names(static_cast<const Group *>(node)->expr, see);
+  case NodeKind::_index: {
+    auto *index = static_cast<const Index *>(node);
+    return names(index->left, see) && names(index->index, see);
+  }
+  case NodeKind::slice: {
+    auto *slice = static_cast<const Slice *>(node);
+    return names(slice->left, see) && names(slice->start, see) &&
+           names(slice->end, see);
+  }
+  case NodeKind::_call:
+    for (auto *arg : static_cast<const Call *>(node)->args)
+      if (!names(arg, see))
+        return false;
+    return true;
+  case NodeKind::builtin:
+    for (auto *arg : static_cast<const Builtin *>(node)->args)
+      if (!names(arg, see))
+        return false;
+    return true;
+  case NodeKind::array:
+    for (auto *elem : static_cast<const ArrayLit *>(node)->elems)
+      if (!names(elem, see))
+        return false;
+    return true;
+  case NodeKind::range: {
+    auto *range = static_cast<const Range *>(node);
+    return names(range->start, see) && names(range->end, see);
+  }
+  default:
+    return false;
+  }
+}
+
+static bool names(const Node::Stmt *node, const See &see) {
+  if (!node)
+    return true;
+  switch (node->kind) {
+  case NodeKind::block_stmt: {
+    auto *block = static_cast<const BlockStmt *>(node);
+    for (std::size_t i = 0; i < block->size; i++)
+      if (!names(block->stmt[i], see))
+        return false;
+    return true;
+  }
+  case NodeKind::expr_stmt:
+    return names(static_cast<const ExprStmt *>(node)->expr, see);
+  case NodeKind::var_stmt: {
+    auto *var = static_cast<const VarStmt *>(node);
+    if (!names(var->expr, see))
+      return false;
+    see(var->name, Use::declare);
+    return true;
+  }
+  case NodeKind::return_stmt:
+    return names(static_cast<const ReturnStmt *>(node)->expr, see);
+  case NodeKind::print_stmt: {
+    auto *print = static_cast<const PrintStmt *>(node);
+    if (!names(print->fd, see))
+      return false;
+    for (std::size_t i = 0; i < print->size; i++)
+      if (!names(print->args[i], see))
+        return false;
+    return true;
+  }
+  case NodeKind::if_stmt: {
+    auto *if_stmt = static_cast<const IfStmt *>(node);
+    return names(if_stmt->condition, see) && names(if_stmt->block, see) &&
+           names(if_stmt->else_block, see);
+  }
+  case NodeKind::loop_stmt: {
+    auto *loop = static_cast<const LoopStmt *>(node);
+    if (!loop->var.empty())
+      see(loop->var, Use::declare);
+    for (const LoopStmt::Reduction &r : loop->reductions)
+      see(r.var, Use::write);
+    return names(loop->init, see) && names(loop->condition, see) &&
+           names(loop->optional, see) && names(loop->block, see);
+  }
+  default:
+    return false;
+  }
+}
+
+// Whether running `node` can rebind the variable `name`, by assigning to it,
+// stepping it or declaring another variable of that name. Anything not known
+// here might.
+static bool writes(const Node::Stmt *node, const std::string &name) {
+  bool written = false;
+  bool known = names(node, [&](const std::string &n, Use use) {
+    written = written || (n == name && use != Use::read);
+  });
+  return written || !known;
+}
+
+// A variable only the function it is in can rebind: a local, or in the body
+// of a @parallel loop a local of the function around it. A function called
+// from a loop could rebind a global.
+static bool is_local(const llvm::Value *slot) {
+  return slot->getType()->isPointerTy() &&
+         !llvm::isa<llvm::GlobalVariable>(slot);
+}
+
+// What a loop that takes i from `start` up by one while `i < bound`, or
+// `i <= bound` when inclusive, proves about i in its body. When i starts at
+// zero or more it stays inside [0, bound), where the bound is `@len(a)` of
+// an `a` the body leaves alone, or a constant.
+static std::optional<Codegen::InBounds>
+bound_fact(const std::string &i, const llvm::Value *start,
+           const Node::Expr *bound, bool inclusive, const Node::Stmt *body,
+           std::map<std::string, llvm::Value *> &namedValues) {
+  auto *first = llvm::dyn_cast_or_null<llvm::ConstantInt>(start);
+  if (!first || first->isNegative())
+    return std::nullopt;
+
+  if (auto *len = dynamic_cast<const Builtin *>(bound);
+      len && !inclusive && len->name == "len" && len->args.size() == 1) {
+    auto *array = dynamic_cast<const Ident *>(len->args[0]);
+    auto local = array ? namedValues.find(array->ident) : namedValues.end();
+    if (local != namedValues.end() && is_local(local->second) &&
+        !writes(body, array->ident))
+      return Codegen::InBounds{i, array->ident, 0};
+  }
+  // A limit that ..= would push past INT64_MAX proves nothing, rather than
+  // wrapping around to one that lets every index through
+  std::int64_t value = 0, end = 0;
+  if (auto *limit = dynamic_cast<const Number *>(bound);
+      limit && !llvm::StringRef(limit->value).getAsInteger(10, value) &&
+      !llvm::AddOverflow(value, std::int64_t(inclusive), end))
+    return Codegen::InBounds{i, "", end};
+  return std::nullopt;
+}
+
+// What a counting loop `loop (i < bound) : (i++)` proves about i in its
+// body, when the body leaves i alone. Must be called in the preheader,
+// before the branch into the loop.
+static std::optional<Codegen::InBounds>
+counting_loop(const LoopStmt &loop, llvm::IRBuilder<> &builder,
+              std::map<std::string, llvm::Value *> &namedValues) {
+  auto *cond = dynamic_cast<const Binary *>(loop.condition);
+  auto *step = dynamic_cast<const Prefix *>(loop.optional);
+  if (!cond || cond->op != "<" || !step || step->op != "++")
+    return std::nullopt;
+  auto *i = dynamic_cast<const Ident *>(cond->left);
+  if (!i || !is_ident(step->left, i->ident) || writes(loop.block, i->ident))
+    return std::nullopt;
+
+  // Where i starts: the last store to it before the loop, which has to be
+  // in the preheader itself
+  auto slot = namedValues.find(i->ident);
+  if (slot == namedValues.end() || !is_local(slot->second))
+    return std::nullopt;
+  llvm::BasicBlock *pre = builder.GetInsertBlock();
+  const llvm::Value *start = nullptr;
+  for (auto it = pre->rbegin(); it != pre->rend() && !start; ++it) {
+    auto *store = llvm::dyn_cast<llvm::StoreInst>(&*it);
+    if (store && store->getPointerOperand() == slot->second)
+      start = store->getValueOperand();
+  }
+  return bound_fact(i->ident, start, cond->right, false, loop.block,
+                    namedValues);
+}
+
+static bool has_hints(const LoopStmt &loop) {
+  return loop.unroll != 0 || loop.vectorize != 0 || loop.interleave != 0 ||
+         loop.novectorize;
+}
+
+// The !llvm.loop of a loop's latch branch: a distinct node that refers to
+// itself, then the loop's hints as the loop passes spell them. Only a loop
+// that always ends may say it must make progress, a `loop (1)` may not.
+static llvm::MDNode *loop_id(llvm::LLVMContext &ctx, const LoopStmt &loop,
+                             bool must_progress) {
+  auto flag = [&](const char *name) -> llvm::Metadata * {
+    return llvm::MDNode::get(ctx, llvm::MDString::get(ctx, name));
+  };
+  auto value = [&](const char *name, llvm::Constant *v) -> llvm::Metadata * {
+    return llvm::MDNode::get(ctx, {llvm::MDString::get(ctx, name),
+                                   llvm::ConstantAsMetadata::get(v)});
+  };
+  llvm::Type *i32 = llvm::Type::getInt32Ty(ctx);
+
+  std::vector<llvm::Metadata *> ops = {nullptr};
+  if (must_progress)
+    ops.push_back(flag("llvm.loop.mustprogress"));
+  if (loop.unroll == 1)
+    ops.push_back(flag("llvm.loop.unroll.disable"));
+  else if (loop.unroll > 1)
+    ops.push_back(value("llvm.loop.unroll.count",
+                        llvm::ConstantInt::get(i32, loop.unroll)));
+  if (loop.novectorize)
+    ops.push_back(value("llvm.loop.vectorize.width",
+                        llvm::ConstantInt::get(i32, 1)));
+  if (loop.vectorize != 0) {
+    ops.push_back(value("llvm.loop.vectorize.enable",
+                        llvm::ConstantInt::getTrue(ctx)));
+    ops.push_back(value("llvm.loop.vectorize.width",
+                        llvm::ConstantInt::get(i32, loop.vectorize)));
+  }
+  if (loop.interleave != 0)
+    ops.push_back(value("llvm.loop.interleave.count",
+                        llvm::ConstantInt::get(i32, loop.interleave)));
+
+  llvm::MDNode *id = llvm::MDNode::getDistinct(ctx, ops);
+  id->replaceOperandWith(0, id);
+  return id;
+}
+
+// The loop of a range loop over [start, stop), entered when `enter`. i is a
+// phi in the body's first block instead of a slot that is stored and
+// reloaded, and the exit compares against a `stop` fixed before the loop.
+// `nsw` says i + 1 cannot wrap.
+//
+//   preheader ─┬─> body ... latch ─┬─> after
+//              │   ^───────────────┘     ^
+//              └─────────────────────────┘
+static void counted_loop(const LoopStmt &loop, llvm::Value *start,
+                         llvm::Value *stop, llvm::Value *enter, bool nsw,
+                         const std::optional<Codegen::InBounds> &fact,
+                         llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+                         llvm::Module &module,
+                         std::map<std::string, llvm::Value *> &namedValues) {
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *pre = builder.GetInsertBlock();
+  llvm::BasicBlock *body = llvm::BasicBlock::Create(ctx, "range.body", function);
+  llvm::BasicBlock *after =
+      llvm::BasicBlock::Create(ctx, "range.after", function);
+  builder.CreateCondBr(enter, body, after);
+
+  builder.SetInsertPoint(body);
+  llvm::PHINode *i = builder.CreatePHI(builder.getInt64Ty(), 2, loop.var);
+  i->addIncoming(start, pre);
+
+  auto shadowed = namedValues.find(loop.var);
+  llvm::Value *outer =
+      shadowed != namedValues.end() ? shadowed->second : nullptr;
+  namedValues[loop.var] = i;
+  if (loop.block) {
+    Codegen::LoopFactsScope scope;
+    if (fact)
+      Codegen::bounds_facts().loops.push_back(*fact);
+    loop.block->codegen(ctx, builder, module, namedValues);
+  }
+  if (outer)
+    namedValues[loop.var] = outer;
+  else
+    namedValues.erase(loop.var);
+
+  // A body that always returns never gets back around
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    llvm::BasicBlock *latch = builder.GetInsertBlock();
+    llvm::Value *next =
+        nsw ? builder.CreateNSWAdd(i, builder.getInt64(1), loop.var + ".next")
+            : builder.CreateAdd(i, builder.getInt64(1), loop.var + ".next");
+    llvm::Value *done = builder.CreateICmpEQ(next, stop, "range.done");
+    llvm::BranchInst *back = builder.CreateCondBr(done, after, body);
+    back->setMetadata(llvm::LLVMContext::MD_loop, loop_id(ctx, loop, true));
+    i->addIncoming(next, latch);
+  }
+
+  builder.SetInsertPoint(after);
+}
+
+// What each chunk's part of a reduction starts from
+static llvm::Constant *identity(const std::string &op, llvm::Type *type) {
+  if (type->isDoubleTy()) {
+    if (op == "min" || op == "max")
+      return llvm::ConstantFP::getInfinity(type, op == "max");
+    return llvm::ConstantFP::get(type, op == "*" ? 1.0 : 0.0);
+  }
+  unsigned bits = type->getIntegerBitWidth();
+  if (op == "min")
+    return llvm::ConstantInt::get(type, llvm::APInt::getSignedMaxValue(bits));
+  if (op == "max")
+    return llvm::ConstantInt::get(type, llvm::APInt::getSignedMinValue(bits));
+  return llvm::ConstantInt::get(type, op == "*" ? 1 : 0);
+}
+
+static llvm::Value *reduce(llvm::IRBuilder<> &builder, const std::string &op,
+                           llvm::Value *a, llvm::Value *b) {
+  bool fp = a->getType()->isDoubleTy();
+  if (op == "+")
+    return fp ? builder.CreateFAdd(a, b) : builder.CreateAdd(a, b);
+  if (op == "*")
+    return fp ? builder.CreateFMul(a, b) : builder.CreateMul(a, b);
+  if (fp)
+    return op == "min" ? builder.CreateMinNum(a, b)
+                       : builder.CreateMaxNum(a, b);
+  return builder.CreateSelect(op == "min" ? builder.CreateICmpSLT(a, b)
+                                          : builder.CreateICmpSGT(a, b),
+                              a, b);
+}
+
+// Folds a chunk's `part` into the variable at `slot` without a lock: one
+// atomicrmw where there is one for the op, a compare and swap loop where
+// there is not. Monotonic is enough, zura_parallel_for only returns once
+// every chunk is done.
+static void combine(llvm::IRBuilder<> &builder, const std::string &op,
+                    llvm::Value *slot, llvm::Value *part) {
+  llvm::Type *type = part->getType();
+  const auto order = llvm::AtomicOrdering::Monotonic;
+  if (op == "+" || !type->isDoubleTy()) {
+    std::optional<llvm::AtomicRMWInst::BinOp> rmw;
+    if (op == "+")
+      rmw = type->isDoubleTy() ? llvm::AtomicRMWInst::FAdd
+                               : llvm::AtomicRMWInst::Add;
+    else if (op == "min")
+      rmw = llvm::AtomicRMWInst::Min;
+    else if (op == "max")
+      rmw = llvm::AtomicRMWInst::Max;
+    if (rmw) {
+      builder.CreateAtomicRMW(*rmw, slot, part, llvm::MaybeAlign(8), order);
+      return;
+    }
+  }
+
+  llvm::LLVMContext &ctx = builder.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::Type *i64 = builder.getInt64Ty();
+  llvm::Value *word = builder.CreatePointerCast(slot, i64->getPointerTo());
+  llvm::LoadInst *first = builder.CreateLoad(i64, word, "reduce.seen");
+  first->setAtomic(order);
+  first->setAlignment(llvm::Align(8));
+  llvm::BasicBlock *pre = builder.GetInsertBlock();
+  llvm::BasicBlock *retry =
+      llvm::BasicBlock::Create(ctx, "reduce.cas", function);
+  llvm::BasicBlock *done =
+      llvm::BasicBlock::Create(ctx, "reduce.done", function);
+  builder.CreateBr(retry);
+
+  builder.SetInsertPoint(retry);
+  llvm::PHINode *seen = builder.CreatePHI(i64, 2, "reduce.old");
+  seen->addIncoming(first, pre);
+  llvm::Value *current = builder.CreateBitCast(seen, type);
+  llvm::Value *next =
+      builder.CreateBitCast(reduce(builder, op, current, part), i64);
+  llvm::Value *swap =
+      builder.CreateAtomicCmpXchg(word, seen, next, llvm::MaybeAlign(8), order,
+                                  order);
+  seen->addIncoming(builder.CreateExtractValue(swap, 0), retry);
+  builder.CreateCondBr(builder.CreateExtractValue(swap, 1), done, retry);
+  builder.SetInsertPoint(done);
+}
+
+// `loop @parallel (i in a..b)`. The body becomes a function of its own that
+// runs the iterations [lo, hi), and zura_parallel_for in libs/parallel.c
+// hands it chunks of the range on every core. The variables of this
+// function the body uses are passed to it in one struct, by address, or by
+// value for the variables of range loops around it. Each chunk reduces into
+// a part of its own that starts at the op's identity, and folds the part
+// into the variable once it is done.
+static llvm::Value *
+parallel_loop(const LoopStmt &loop, llvm::Value *start, llvm::Value *stop,
+              const std::optional<Codegen::InBounds> &fact,
+              llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
+              llvm::Module &module,
+              std::map<std::string, llvm::Value *> &namedValues) {
+  llvm::Function *parent = builder.GetInsertBlock()->getParent();
+
+  std::set<std::string> used, written, declared, reduced;
+  bool known = names(loop.block, [&](const std::string &name, Use use) {
+    if (use == Use::declare)
+      declared.insert(name);
+    else
+      used.insert(name);
+    if (use == Use::write)
+      written.insert(name);
+  });
+
+  for (const LoopStmt::Reduction &r : loop.reductions) {
+    auto it = namedValues.find(r.var);
+    llvm::Type *type = it != namedValues.end() &&
+                               it->second->getType()->isPointerTy()
+                           ? it->second->getType()->getPointerElementType()
+                           : nullptr;
+    if (!type || !(type->isIntegerTy(64) || type->isDoubleTy())) {
+      Codegen::err() << "@reduce(" << r.op << ": " << r.var
+                     << ") needs an int or float variable" << std::endl;
+      return nullptr;
+    }
+    reduced.insert(r.var);
+  }
+
+  // Every iteration assigning the same variable is a race, unless the loop
+  // reduces into it
+  for (const std::string &name : written) {
+    auto it = namedValues.find(name);
+    if (!declared.count(name) && !reduced.count(name) &&
+        it != namedValues.end() && it->second->getType()->isPointerTy()) {
+      Codegen::err() << "Every iteration of a @parallel loop assigns " << name
+                     << ", reduce into it with @reduce(op: " << name << ")"
+                     << std::endl;
+      return nullptr;
+    }
+  }
+
+  // Globals are reached directly. When the body holds something names()
+  // cannot look into, every local goes along.
+  std::vector<std::pair<std::string, llvm::Value *>> captures;
+  std::vector<llvm::Type *> fields;
+  for (const auto &[name, binding] : namedValues) {
+    auto *local = llvm::dyn_cast<llvm::Instruction>(binding);
+    if (name == loop.var || !local || local->getFunction() != parent)
+      continue;
+    if (known && !used.count(name) && !reduced.count(name))
+      continue;
+    captures.push_back({name, binding});
+    fields.push_back(binding->getType());
+  }
+  llvm::StructType *env_type = llvm::StructType::get(ctx, fields);
+
+  llvm::Type *i64 = builder.getInt64Ty();
+  auto *chunk_type = llvm::FunctionType::get(
+      builder.getVoidTy(), {i64, i64, builder.getInt8PtrTy()}, false);
+  llvm::Function *chunk =
+      llvm::Function::Create(chunk_type, llvm::Function::InternalLinkage,
+                             parent->getName() + ".parallel", module);
+  // @fastmath carries over to the body
+  for (const llvm::Attribute &attr : parent->getAttributes().getFnAttrs())
+    if (attr.isStringAttribute())
+      chunk->addFnAttr(attr);
+
+  {
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", chunk));
+    llvm::Value *lo = chunk->getArg(0);
+    llvm::Value *hi = chunk->getArg(1);
+    lo->setName("lo");
+    hi->setName("hi");
+    chunk->getArg(2)->setName("env");
+
+    std::map<std::string, llvm::Value *> inner = namedValues;
+    llvm::Value *env =
+        builder.CreatePointerCast(chunk->getArg(2), env_type->getPointerTo());
+    for (unsigned f = 0; f < captures.size(); f++)
+      inner[captures[f].first] = builder.CreateLoad(
+          fields[f], builder.CreateStructGEP(env_type, env, f),
+          captures[f].first);
+
+    std::vector<std::pair<llvm::Value *, llvm::AllocaInst *>> parts;
+    for (const LoopStmt::Reduction &r : loop.reductions) {
+      llvm::Value *slot = inner[r.var];
+      llvm::Type *type = slot->getType()->getPointerElementType();
+      llvm::AllocaInst *part =
+          Codegen::entry_alloca(builder, type, r.var + ".part");
+      builder.CreateStore(identity(r.op, type), part);
+      inner[r.var] = part;
+      parts.push_back({slot, part});
+    }
+
+    {
+      llvm::SaveAndRestore<bool> guard(in_parallel_body, true);
+      counted_loop(loop, lo, hi,
+                   builder.CreateICmpSLT(lo, hi, "chunk.enter"), true, fact,
+                   ctx, builder, module, inner);
+    }
+
+    for (std::size_t r = 0; r < parts.size(); r++) {
+      llvm::AllocaInst *part = parts[r].second;
+      combine(builder, loop.reductions[r].op, parts[r].first,
+              builder.CreateLoad(part->getAllocatedType(), part));
+    }
+    builder.CreateRetVoid();
+  }
+
+  llvm::Value *env = Codegen::entry_alloca(builder, env_type, "parallel.env");
+  for (unsigned f = 0; f < captures.size(); f++)
+    builder.CreateStore(captures[f].second,
+                        builder.CreateStructGEP(env_type, env, f));
+  llvm::FunctionCallee run = Codegen::runtime_fn(
+      builder, "zura_parallel_for", builder.getVoidTy(),
+      {i64, i64, chunk_type->getPointerTo(), builder.getInt8PtrTy()});
+  builder.CreateCall(
+      run, {start, stop, chunk,
+            builder.CreatePointerCast(env, builder.getInt8PtrTy())});
+  return llvm::Constant::getNullValue(i64); // dummy return
+}
+
+// `loop (i in a..b)` lowered straight to the canonical form the loop passes
+// look for. The bounds are evaluated once, before the loop.
+static llvm::Value *
+range_loop(const LoopStmt &loop, llvm::LLVMContext &ctx,
+           llvm::IRBuilder<> &builder, llvm::Module &module,
+           std::map<std::string, llvm::Value *> &namedValues) {
+  auto *range = static_cast<const Range *>(loop.condition);
+  llvm::Value *start = range->start->codegen(ctx, builder, namedValues);
+  llvm::Value *end = range->end->codegen(ctx, builder, namedValues);
+  if (!start || !end)
+    return nullptr;
+  if (!start->getType()->isIntegerTy() || !end->getType()->isIntegerTy()) {
+    Codegen::err() << "The bounds of a range must be ints" << std::endl;
+    return nullptr;
+  }
+  llvm::Type *i64 = builder.getInt64Ty();
+  start = Codegen::convert(builder, start, i64);
+  end = Codegen::convert(builder, end, i64);
+
+  // The first value past the range. With ..= up to the largest int this
+  // wraps around, which the exit test still gets right as i wraps the same
+  // way.
+  llvm::Value *stop =
+      range->inclusive
+          ? builder.CreateAdd(end, builder.getInt64(1), "range.stop")
+          : end;
+
+  std::optional<Codegen::InBounds> fact;
+  if (!writes(loop.block, loop.var))
+    fact = bound_fact(loop.var, start, range->end, range->inclusive,
+                      loop.block, namedValues);
+  if (loop.parallel)
+    return parallel_loop(loop, start, stop, fact, ctx, builder, module,
+                         namedValues);
+
+  llvm::Value *enter = range->inclusive
+                           ? builder.CreateICmpSLE(start, end, "range.enter")
+                           : builder.CreateICmpSLT(start, end, "range.enter");
+  // i < end before the step unless the range is inclusive
+  counted_loop(loop, start, stop, enter, !range->inclusive, fact, ctx, builder,
+               module, namedValues);
+  return llvm::Constant::getNullValue(i64); // dummy return
+}
+
 llvm::Value *
 LoopStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
                   llvm::Module &module,
                   std::map<std::string, llvm::Value *> &namedValues) const {
+  if (!var.empty())
+    return range_loop(*this, ctx, builder, module, namedValues);
+
   llvm::Function *function = builder.GetInsertBlock()->getParent();
 
   // preHeaderBB
@@ -325,6 +986,11 @@ LoopStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (is_for && init)
     init->codegen(ctx, builder, namedValues);
 
+  // Indexing with the loop's counter in the body can skip its bounds check
+  // when the loop proves the counter is in bounds
+  std::optional<Codegen::InBounds> fact =
+      counting_loop(*this, builder, namedValues);
+
   builder.CreateBr(condBB);
 
   builder.SetInsertPoint(condBB);
@@ -334,9 +1000,7 @@ LoopStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
     if (!cond_value)
       return nullptr;
 
-    cond_value = builder.CreateICmpNE(
-        cond_value, llvm::ConstantInt::get(cond_value->getType(), 0),
-        "loopcond");
+    cond_value = Codegen::truthy(builder, cond_value, "loopcond");
   } else {
     cond_value = llvm::ConstantInt::getTrue(ctx);
   }
@@ -345,6 +1009,9 @@ LoopStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
 
   builder.SetInsertPoint(bodyBB);
   if (block) {
+    Codegen::LoopFactsScope scope;
+    if (fact)
+      Codegen::bounds_facts().loops.push_back(*fact);
     block->codegen(ctx, builder, module, namedValues);
   }
   builder.CreateBr(stepBB); // Only one terminator
@@ -353,11 +1020,14 @@ LoopStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (optional) {
     optional->codegen(ctx, builder, namedValues);
   }
-  builder.CreateBr(condBB); // Only one terminator
+  llvm::BranchInst *back = builder.CreateBr(condBB); // Only one terminator
+  if (has_hints(*this))
+    back->setMetadata(llvm::LLVMContext::MD_loop, loop_id(ctx, *this, false));
 
   builder.SetInsertPoint(afterBB);
 
-  return nullptr;
+  return llvm::Constant::getNullValue(
+      llvm::Type::getInt64Ty(ctx)); // dummy return
 }
 
 llvm::Value *
@@ -377,9 +1047,7 @@ IfStmt::codegen(llvm::LLVMContext &ctx, llvm::IRBuilder<> &builder,
   if (!cond_value)
     return nullptr;
 
-  cond_value = builder.CreateICmpNE(
-      cond_value, llvm::ConstantInt::get(cond_value->getType(), 0),
-      "ifcond");
+  cond_value = Codegen::truthy(builder, cond_value, "ifcond");
 
   builder.CreateCondBr(cond_value, thenBB, elseBB);
 
@@ -0,0 +1,121 @@
+#include "llvm.hpp"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/Support/xxhash.h>
+#include <string>
+
+llvm::StructType *Codegen::str_type(llvm::LLVMContext &ctx) {
+  // Literal struct types are uniqued by the context, so this is the same
+  // type every time and partitions in other contexts agree on its layout
+  return llvm::StructType::get(llvm::Type::getInt8PtrTy(ctx),
+                               llvm::Type::getInt64Ty(ctx));
+}
+
+bool Codegen::is_str(llvm::Type *type) {
+  return type == str_type(type->getContext());
+}
+
+llvm::Value *Codegen::make_str(llvm::IRBuilder<> &builder, llvm::Value *ptr,
+                               llvm::Value *len) {
+  llvm::Value *str = llvm::UndefValue::get(str_type(builder.getContext()));
+  str = builder.CreateInsertValue(str, ptr, 0);
+  return builder.CreateInsertValue(str, len, 1);
+}
+
+llvm::Constant *Codegen::pooled_string(llvm::IRBuilder<> &builder,
+                                       llvm::StringRef bytes) {
+  llvm::Module *module = builder.GetInsertBlock()->getModule();
+  // Still NUL terminated, which is what lets the backend put them in a
+  // mergeable section so the linker folds equal strings across objects
+  llvm::Constant *data =
+      llvm::ConstantDataArray::getString(builder.getContext(), bytes, true);
+
+  // The pool is the module's own symbol table: a string lives in a global
+  // named after the hash of its bytes, so a lookup is one name lookup, and
+  // the names do not depend on the order strings were asked for in.
+  // Constants are uniqued, so comparing initializers compares the bytes.
+  std::string name = "str." + llvm::utohexstr(llvm::xxHash64(bytes));
+  llvm::GlobalVariable *global = nullptr;
+  for (unsigned collision = 0;; collision++) {
+    std::string candidate =
+        collision == 0 ? name : name + "." + std::to_string(collision);
+    global = module->getNamedGlobal(candidate);
+    if (!global) {
+      global = new llvm::GlobalVariable(*module, data->getType(), true,
+                                        llvm::GlobalValue::PrivateLinkage,
+                                        data, candidate);
+      global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+      global->setAlignment(llvm::Align(1));
+      break;
+    }
+    if (global->hasInitializer() && global->getInitializer() == data)
+      break;
+  }
+
+  llvm::Constant *zero = builder.getInt64(0);
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(
+      global->getValueType(), global, llvm::ArrayRef<llvm::Constant *>{zero, zero});
+}
+
+llvm::Constant *Codegen::str_literal(llvm::IRBuilder<> &builder,
+                                     llvm::StringRef bytes) {
+  llvm::Constant *ptr = pooled_string(builder, bytes);
+  return llvm::ConstantStruct::get(str_type(builder.getContext()),
+                                   {ptr, builder.getInt64(bytes.size())});
+}
+
+llvm::FunctionCallee Codegen::runtime_fn(llvm::IRBuilder<> &builder,
+                                         llvm::StringRef name,
+                                         llvm::Type *ret,
+                                         llvm::ArrayRef<llvm::Type *> params) {
+  llvm::Module *module = builder.GetInsertBlock()->getModule();
+  return module->getOrInsertFunction(
+      name, llvm::FunctionType::get(ret, params, false));
+}
+
+llvm::Value *Codegen::str_binary(llvm::IRBuilder<> &builder,
+                                 const std::string &op, llvm::Value *a,
+                                 llvm::Value *b) {
+  llvm::Type *i8_ptr = builder.getInt8PtrTy();
+  llvm::Type *i64 = builder.getInt64Ty();
+  llvm::Value *a_ptr = builder.CreateExtractValue(a, 0, "a.ptr");
+  llvm::Value *a_len = builder.CreateExtractValue(a, 1, "a.len");
+  llvm::Value *b_ptr = builder.CreateExtractValue(b, 0, "b.ptr");
+  llvm::Value *b_len = builder.CreateExtractValue(b, 1, "b.len");
+
+  if (op == "+") {
+    llvm::FunctionCallee concat = runtime_fn(
+        builder, "zura_str_concat", i8_ptr, {i8_ptr, i64, i8_ptr, i64});
+    llvm::Value *ptr =
+        builder.CreateCall(concat, {a_ptr, a_len, b_ptr, b_len}, "concat");
+    return make_str(builder, ptr, builder.CreateAdd(a_len, b_len, "len"));
+  }
+
+  // Equality only needs the bytes when the lengths match
+  if (op == "==" || op == "!=") {
+    llvm::FunctionCallee equal = runtime_fn(
+        builder, "zura_str_equal", i64, {i8_ptr, i64, i8_ptr, i64});
+    llvm::Value *eq = builder.CreateCall(equal, {a_ptr, a_len, b_ptr, b_len});
+    return op == "==" ? builder.CreateICmpNE(eq, builder.getInt64(0), "eqtmp")
+                      : builder.CreateICmpEQ(eq, builder.getInt64(0), "netmp");
+  }
+
+  llvm::CmpInst::Predicate pred;
+  if (op == "<")
+    pred = llvm::CmpInst::ICMP_SLT;
+  else if (op == "<=")
+    pred = llvm::CmpInst::ICMP_SLE;
+  else if (op == ">")
+    pred = llvm::CmpInst::ICMP_SGT;
+  else if (op == ">=")
+    pred = llvm::CmpInst::ICMP_SGE;
+  else
+    return nullptr;
+
+  llvm::FunctionCallee compare = runtime_fn(
+      builder, "zura_str_compare", i64, {i8_ptr, i64, i8_ptr, i64});
+  llvm::Value *cmp = builder.CreateCall(compare, {a_ptr, a_len, b_ptr, b_len});
+  return builder.CreateICmp(pred, cmp, builder.getInt64(0), "cmptmp");
+}
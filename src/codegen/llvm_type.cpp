@@ -1,19 +1,32 @@
 #include "../ast/type.hpp"
+#include "llvm.hpp"
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
 
 llvm::Type *SymbolType::codegen(llvm::LLVMContext &ctx) const {
-  // NOTE: Handle strings
+  // [N]T and []T, spelled that way by Parser::parse_type
+  if (!name.empty() && name[0] == '[') {
+    std::size_t close = name.find(']');
+    llvm::Type *elem = SymbolType(name.substr(close + 1)).codegen(ctx);
+    if (elem->isVoidTy())
+      throw std::runtime_error("Arrays of nil are not allowed");
+    if (close == 1)
+      return Codegen::slice_type(elem);
+    return llvm::ArrayType::get(elem, std::stoull(name.substr(1, close - 1)));
+  }
   if (name == "uint" || name == "int")
     return llvm::Type::getInt64Ty(ctx);
-  if (name == "float")
+  if (name == "float" || name == "f64")
     return llvm::Type::getDoubleTy(ctx);
   if (name == "char")
     return llvm::Type::getInt8Ty(ctx);
   if (name == "str")
-    return llvm::Type::getInt8Ty(ctx)->getPointerTo();
+    return Codegen::str_type(ctx);
+  // A handle to the runtime's builder, see libs/str.c
+  if (name == "strbuf")
+    return llvm::Type::getInt8PtrTy(ctx);
   if (name == "bool")
     return llvm::Type::getInt1Ty(ctx);
   if (name == "nil")
@@ -21,3 +34,41 @@ llvm::Type *SymbolType::codegen(llvm::LLVMContext &ctx) const {
 
   throw std::runtime_error("Unknown type: " + name);
 }
+
+llvm::Value *Codegen::convert(llvm::IRBuilder<> &builder, llvm::Value *value,
+                              llvm::Type *to) {
+  llvm::Type *from = value->getType();
+  if (from == to)
+    return value;
+  if (from->isIntegerTy() && to->isFloatingPointTy())
+    return from->isIntegerTy(1) ? builder.CreateUIToFP(value, to)
+                                : builder.CreateSIToFP(value, to);
+  if (from->isFloatingPointTy() && to->isIntegerTy())
+    return builder.CreateFPToSI(value, to);
+  if (from->isIntegerTy() && to->isIntegerTy())
+    return builder.CreateIntCast(value, to, !from->isIntegerTy(1));
+  // An array literal passed or stored as a slice lives on the stack of the
+  // function it was made in
+  if (from->isArrayTy() && is_slice(to)) {
+    llvm::Type *array =
+        llvm::ArrayType::get(slice_elem(to), from->getArrayNumElements());
+    llvm::AllocaInst *slot = entry_alloca(builder, array, "lit");
+    if (!store(builder, slot, array, value))
+      return value;
+    return make_slice(builder,
+                      builder.CreateConstInBoundsGEP2_64(array, slot, 0, 0),
+                      builder.getInt64(from->getArrayNumElements()));
+  }
+  return value;
+}
+
+llvm::Value *Codegen::truthy(llvm::IRBuilder<> &builder, llvm::Value *value,
+                             const llvm::Twine &name) {
+  if (is_str(value->getType()))
+    value = builder.CreateExtractValue(value, 1, "len");
+  if (value->getType()->isFloatingPointTy())
+    return builder.CreateFCmpUNE(
+        value, llvm::ConstantFP::get(value->getType(), 0.0), name);
+  return builder.CreateICmpNE(
+      value, llvm::ConstantInt::get(value->getType(), 0), name);
+}
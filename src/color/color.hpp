@@ -26,8 +26,9 @@ private:
   };
 
   std::string colorCode(C color) {
-    if (colorMap.find(color) != colorMap.end())
-      return colorMap[color];
+    auto it = colorMap.find(color);
+    if (it != colorMap.end())
+      return it->second;
     return "";
   }
 
@@ -0,0 +1,237 @@
+#include "ast_file.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "../ast/decode.hpp"
+#include "../ast/encode.hpp"
+#include "../ast/stmt.hpp"
+#include "../cache/cache.hpp"
+#include "../thread/pool.hpp"
+#include "../trace/trace.hpp"
+
+using namespace Allocator;
+using namespace Driver;
+
+namespace {
+using u32 = llvm::support::ulittle32_t;
+
+constexpr char magic[4] = {'Z', 'A', 'S', 'T'};
+// Bump whenever the canonical encoding changes
+constexpr std::uint32_t version = 8;
+constexpr std::size_t hash_size = 40;
+
+struct Decl {
+  u32 offset; // from the start of the file
+  u32 size;
+};
+
+struct Header {
+  char magic[4];
+  u32 version;
+  u32 size;
+  char source[hash_size];
+  u32 decls; // offset of the Decl table
+  u32 count;
+};
+
+static_assert(alignof(Header) == 1 && alignof(Decl) == 1,
+              "entries are read in place from any offset");
+
+// Checks the header and finds the declaration table, null if either is bad
+const Decl *decls_of(llvm::StringRef data, const Header *&header) {
+  if (data.size() < sizeof(Header))
+    return nullptr;
+  header = reinterpret_cast<const Header *>(data.data());
+  if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+      header->version != version || header->size != data.size() ||
+      std::uint64_t(header->decls) +
+              std::uint64_t(header->count) * sizeof(Decl) >
+          data.size())
+    return nullptr;
+
+  auto *decls = reinterpret_cast<const Decl *>(data.data() + header->decls);
+  for (std::size_t i = 0; i < header->count; i++) {
+    if (std::uint64_t(decls[i].offset) + decls[i].size > data.size())
+      return nullptr;
+  }
+  return decls;
+}
+
+std::string sidecar(const Module &m) {
+  llvm::SmallString<256> path(m.path);
+  llvm::sys::path::replace_extension(path, "zast");
+  return std::string(path);
+}
+
+std::string cache_key(const Module &m) {
+  return Cache::key({Cache::compiler_id(), "ast", m.source.text()});
+}
+} // namespace
+
+std::string Driver::source_hash(llvm::StringRef source) {
+  return Cache::key({source});
+}
+
+std::string Driver::write_ast(const ProgramStmt *program,
+                              const std::string &hash) {
+  Header header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  std::memcpy(header.source, hash.data(), std::min(hash.size(), hash_size));
+  header.decls = std::uint32_t(sizeof(Header));
+  header.count = std::uint32_t(program->size);
+
+  std::string out(sizeof(Header) + program->size * sizeof(Decl), '\0');
+  std::vector<Decl> decls(program->size);
+  for (std::size_t i = 0; i < program->size; i++) {
+    Encoder e;
+    e.node(program->stmts[i]);
+    decls[i].offset = std::uint32_t(out.size());
+    decls[i].size = std::uint32_t(e.out.size());
+    out += e.out;
+  }
+
+  header.size = std::uint32_t(out.size());
+  std::memcpy(out.data(), &header, sizeof(Header));
+  std::memcpy(out.data() + sizeof(Header), decls.data(),
+              decls.size() * sizeof(Decl));
+  return out;
+}
+
+ProgramStmt *Driver::read_ast(
+    llvm::StringRef data, const std::string &hash, ArenaAllocator &arena,
+    std::vector<std::unique_ptr<ArenaAllocator>> &chunk_arenas,
+    std::size_t jobs) {
+  const Header *header;
+  const Decl *decls = decls_of(data, header);
+  if (decls == nullptr ||
+      (!hash.empty() &&
+       llvm::StringRef(header->source, hash_size) != llvm::StringRef(hash)))
+    return nullptr;
+
+  // Contiguous runs of declarations, each decoded into its own arena
+  std::size_t count = header->count;
+  std::size_t chunks = std::max<std::size_t>(1, std::min(jobs, count));
+  std::vector<std::unique_ptr<ArenaAllocator>> arenas;
+  for (std::size_t c = 0; chunks > 1 && c < chunks; c++)
+    arenas.push_back(std::make_unique<ArenaAllocator>(1024));
+
+  std::vector<Node::Stmt *> stmts(count, nullptr);
+  std::vector<char> ok(chunks, 1);
+  Thread::parallel_for(chunks, jobs, [&](std::size_t c) {
+    Trace::Scope scope("decode ast");
+    ArenaAllocator &into = arenas.empty() ? arena : *arenas[c];
+    for (std::size_t i = count * c / chunks; i < count * (c + 1) / chunks;
+         i++) {
+      const char *begin = data.data() + decls[i].offset;
+      Decoder d(begin, begin + decls[i].size, into);
+      stmts[i] = d.stmt();
+      if (!d.ok || stmts[i] == nullptr || d.p != d.end)
+        ok[c] = 0;
+    }
+  });
+
+  // Whatever a bad file left in the arenas is freed with them
+  if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+    return nullptr;
+  for (auto &a : arenas)
+    chunk_arenas.push_back(std::move(a));
+  return arena.emplace<ProgramStmt>(stmts, arena);
+}
+
+bool Driver::load_ast(Module &m, const std::string &cache_dir,
+                      std::size_t jobs) {
+  Trace::Scope scope(Trace::Kind::region, "load ast", m.path);
+  std::string hash;
+  {
+    Trace::Scope hashing("hash source", m.path);
+    hash = source_hash(m.source.text());
+  }
+  auto file = llvm::MemoryBuffer::getFile(sidecar(m), /*IsText=*/false,
+                                          /*RequiresNullTerminator=*/false);
+  std::unique_ptr<llvm::MemoryBuffer> buffers[2];
+  if (file)
+    buffers[0] = std::move(*file);
+  if (!cache_dir.empty())
+    buffers[1] = Cache::map(cache_dir, cache_key(m), "zast");
+
+  for (auto &buffer : buffers) {
+    if (buffer == nullptr)
+      continue;
+    m.program = read_ast(buffer->getBuffer(), hash, *m.arena, m.chunk_arenas,
+                         jobs);
+    if (m.program != nullptr)
+      return true;
+  }
+  return false;
+}
+
+void Driver::store_ast(const Module &m, const std::string &cache_dir) {
+  if (cache_dir.empty())
+    return;
+  Trace::Scope scope("store ast", m.path);
+  Cache::store_text(cache_dir, cache_key(m), "zast",
+                      write_ast(m.program, source_hash(m.source.text())));
+}
+
+bool Driver::emit_ast(const Module &m, std::ostream &err) {
+  if (m.path == "-")
+    return true; // stdin has nowhere to put it
+  std::string path = sidecar(m);
+  std::error_code EC;
+  llvm::raw_fd_ostream out(path, EC);
+  if (EC) {
+    err << "Could not write " << path << ": " << EC.message() << "\n";
+    return false;
+  }
+  out << write_ast(m.program, source_hash(m.source.text()));
+  return true;
+}
+
+int Driver::dump_ast(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " dump-ast <file.zast>\n";
+    return -1;
+  }
+
+  auto buffer = llvm::MemoryBuffer::getFile(argv[2], /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    std::cerr << "Failed to open file: " << argv[2] << "\n";
+    return -1;
+  }
+
+  llvm::StringRef data = (*buffer)->getBuffer();
+  const Header *header;
+  const Decl *decls = decls_of(data, header);
+  if (decls == nullptr) {
+    std::cerr << argv[2] << " is not an AST file of version " << version
+              << "\n";
+    return -1;
+  }
+
+  std::cout << "version: " << header->version << "\n";
+  std::cout << "source:  " << llvm::StringRef(header->source, hash_size).str()
+            << "\n";
+  std::cout << "decls:   " << header->count << "\n\n";
+  for (std::size_t i = 0; i < header->count; i++) {
+    std::cout << "#" << i << " at " << decls[i].offset << ", "
+              << decls[i].size << " bytes\n";
+    ArenaAllocator arena(1024);
+    const char *begin = data.data() + decls[i].offset;
+    Decoder d(begin, begin + decls[i].size, arena);
+    Node::Stmt *stmt = d.stmt();
+    if (!d.ok || stmt == nullptr) {
+      std::cout << "  <malformed>\n";
+      continue;
+    }
+    stmt->debug(std::cout);
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <llvm/ADT/StringRef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../memory/memory.hpp"
+#include "module.hpp"
+
+/*
+ * Serialized ASTs
+ *
+ *   header   magic, version, file size and the hash of the source
+ *   decls    offset and size of every top level declaration
+ *   bodies   each declaration in the canonical encoding of ast/encode.hpp
+ *
+ * Nothing in the file is a pointer. Declarations are found through their
+ * offsets and decoded straight out of the mapped file, in parallel, without
+ * running the lexer or the parser.
+ *
+ * Every module that gets parsed is stored in the build cache. With
+ * -emit-ast the build also writes <module>.zast next to each module, which
+ * is used instead of parsing for as long as the source hash matches.
+ * `zura2 dump-ast <file.zast>` prints one.
+ */
+
+namespace Driver {
+// What a file records to tell whether it still matches the source
+std::string source_hash(llvm::StringRef source);
+
+std::string write_ast(const ProgramStmt *program, const std::string &hash);
+
+// Decodes the program into `arena`, or into chunk arenas when it is split
+// across threads. Null when `data` is not an AST of this version or is for
+// a different source.
+ProgramStmt *
+read_ast(llvm::StringRef data, const std::string &hash,
+         Allocator::ArenaAllocator &arena,
+         std::vector<std::unique_ptr<Allocator::ArenaAllocator>> &chunk_arenas,
+         std::size_t jobs);
+
+// Fills in m.program from <module>.zast or the build cache
+bool load_ast(Module &m, const std::string &cache_dir, std::size_t jobs);
+// Stores a freshly parsed module in the build cache
+void store_ast(const Module &m, const std::string &cache_dir);
+// Writes <module>.zast next to the module
+bool emit_ast(const Module &m, std::ostream &err);
+
+// zura2 dump-ast <file.zast>
+int dump_ast(int argc, char *argv[]);
+}; // namespace Driver
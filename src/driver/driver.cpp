@@ -0,0 +1,703 @@
+#include "driver.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <sstream>
+#include <vector>
+
+#include "../ast/encode.hpp"
+#include "../ast/stmt.hpp"
+#include "../ast/type.hpp"
+#include "../cache/cache.hpp"
+#include "../codegen/llvm.hpp"
+#include "../error/error.hpp"
+#include "../memory/memory.hpp"
+#include "../thread/pool.hpp"
+#include "../trace/trace.hpp"
+#include "ast_file.hpp"
+#include "module.hpp"
+
+using namespace Allocator;
+using namespace Driver;
+
+// Relative paths are relative to the directory the build was started from,
+// which is not the server's working directory
+static std::string resolve(const Options &opts, const std::string &path) {
+  if (opts.workdir.empty() || llvm::sys::path::is_absolute(path) ||
+      path == "-")
+    return path;
+  llvm::SmallString<256> full(opts.workdir);
+  llvm::sys::path::append(full, path);
+  return std::string(full);
+}
+
+// Adds every file the manifest lists to the inputs
+static bool read_manifest(Options &opts, const std::string &path,
+                          std::ostream &err) {
+  Source list;
+  if (!read_file(resolve(opts, path), list, err))
+    return false;
+
+  llvm::StringRef dir = llvm::sys::path::parent_path(path);
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  list.text().split(lines, '\n');
+  for (llvm::StringRef line : lines) {
+    line = line.trim();
+    if (line.empty() || line.startswith("#"))
+      continue;
+    llvm::SmallString<256> file(line);
+    if (!llvm::sys::path::is_absolute(file) && !dir.empty()) {
+      file = dir;
+      llvm::sys::path::append(file, line);
+    }
+    opts.inputs.push_back(std::string(file));
+  }
+  opts.batch = true;
+  return true;
+}
+
+bool Driver::parse_jobs(const std::string &text, std::size_t &jobs) {
+  std::size_t end = 0;
+  long n = 0;
+  try {
+    n = std::stol(text, &end);
+  } catch (const std::exception &) {
+    return false;
+  }
+  if (end != text.size() || n <= 0)
+    return false;
+  jobs = std::size_t(n);
+  return true;
+}
+
+bool Driver::parse_args(int argc, char *argv[], Options &opts,
+                        std::ostream &err) {
+  bool output_given = false;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "-j" || (arg.rfind("-j", 0) == 0 && arg.size() > 2)) {
+      std::string n = arg.size() > 2 ? arg.substr(2) : "";
+      if (n.empty() && i + 1 < argc)
+        n = argv[++i];
+      if (!parse_jobs(n, opts.jobs)) {
+        err << "Expected a thread count after -j\n";
+        return false;
+      }
+    } else if (arg == "-save") {
+      opts.save = true;
+    } else if (arg == "-debug") {
+      opts.debug = true;
+    } else if (arg == "-no-cache") {
+      opts.cache = false;
+    } else if (arg == "-incremental") {
+      opts.incremental = true;
+    } else if (arg == "-lto" || arg == "-lto=full") {
+      opts.lto = true;
+      opts.thin_lto = false;
+    } else if (arg == "-lto=thin") {
+      opts.lto = opts.thin_lto = true;
+    } else if (arg == "-emit-ast") {
+      opts.emit_ast = true;
+    } else if (arg == "--time-report") {
+      opts.time_report = true;
+    } else if (arg == "--mem-report") {
+      opts.mem_report = true;
+    } else if (arg.rfind("--trace=", 0) == 0) {
+      opts.trace = arg.substr(8);
+      if (opts.trace.empty()) {
+        err << "Expected a path after --trace=\n";
+        return false;
+      }
+    } else if (arg == "-o" || arg == "-manifest" || arg == "-runtime") {
+      if (i + 1 == argc || argv[i + 1][0] == '\0') {
+        err << "Expected a path after " << arg << "\n";
+        return false;
+      }
+      if (arg == "-o") {
+        opts.output = argv[++i];
+        output_given = true;
+      } else if (arg == "-runtime") {
+        opts.runtime = argv[++i];
+      } else if (!read_manifest(opts, argv[++i], err)) {
+        return false;
+      }
+    } else if (arg[0] == '-' && arg != "-") {
+      err << "Unknown flag: " << arg << "\n";
+      return false;
+    } else {
+      opts.inputs.push_back(arg);
+    }
+  }
+
+  if (opts.inputs.empty()) {
+    err << "Usage: " << argv[0] << " build <filename>... [-j n] [-o path]\n";
+    return false;
+  }
+  opts.input = opts.inputs[0];
+  opts.batch = opts.batch || opts.inputs.size() > 1;
+  if (opts.batch &&
+      std::find(opts.inputs.begin(), opts.inputs.end(), "-") != opts.inputs.end()) {
+    err << "stdin can only be built on its own\n";
+    return false;
+  }
+  if (opts.batch && !output_given)
+    opts.output = ".";
+  return true;
+}
+
+// What a partition needs from the rest of the build
+struct PartitionJob {
+  const Unit *unit;
+  const std::vector<std::size_t> *stmts;
+  std::string object;
+  std::string key;      // per partition cache key, empty when not caching
+  std::string error;    // reported after all partitions finish, in order
+  std::string warnings; // the same, for loop hints that were not honored
+};
+
+// Lowers, optimizes and emits one partition. Runs on a worker thread with
+// its own LLVMContext, so nothing here may touch shared LLVM state.
+static bool compile_partition(PartitionJob &job, const Options &opts,
+                              const Runtime &runtime,
+                              const std::string &cache_dir) {
+  std::string kind = opts.lto ? "bc" : "o";
+  std::string name(llvm::sys::path::filename(job.object));
+  if (!job.key.empty()) {
+    Trace::Scope scope("cache lookup", name);
+    if (Cache::lookup(cache_dir, job.key, kind, job.object))
+      return true;
+  }
+
+  try {
+    llvm::TargetMachine *tm = Codegen::thread_target_machine();
+    if (!tm)
+      return false;
+
+    CodegenContext cg("main");
+    cg.module->setTargetTriple(tm->getTargetTriple().str());
+    cg.module->setDataLayout(tm->createDataLayout());
+
+    {
+      Trace::Scope scope("lower", name);
+      if (!Codegen::lower_partition(job.unit->program, *job.stmts,
+                                    job.unit->imports, cg))
+        return false;
+    }
+    {
+      Trace::Scope scope("link runtime", name);
+      if (!Codegen::link_runtime(*cg.module, runtime.bitcode))
+        return false;
+    }
+    if (Trace::memory())
+      Trace::count("IR instructions", cg.module->getInstructionCount());
+
+    if (opts.save) {
+      std::error_code EC;
+      std::string ll = job.object.substr(0, job.object.size() - 2) + ".ll";
+      llvm::raw_fd_ostream out(ll, EC);
+      if (!EC)
+        cg.module->print(out, nullptr);
+    }
+
+    {
+      Trace::Scope scope("optimize", name);
+      Codegen::optimize(*cg.module, *tm,
+                        !opts.lto        ? Codegen::Pipeline::per_module
+                        : opts.thin_lto ? Codegen::Pipeline::thin_lto_prelink
+                                        : Codegen::Pipeline::lto_prelink,
+                        &job.warnings);
+    }
+    if (Trace::memory())
+      Trace::count("IR instructions after -O2",
+                   cg.module->getInstructionCount());
+    bool ok;
+    {
+      Trace::Scope scope("emit", name);
+      ok = opts.lto ? Codegen::emit_bitcode(*cg.module, job.object,
+                                            opts.thin_lto)
+                    : Codegen::emit_object(*cg.module, *tm, job.object);
+    }
+    if (ok && !job.key.empty()) {
+      Trace::Scope scope("cache store", name);
+      Cache::store(cache_dir, job.key, kind, job.object);
+    }
+    return ok;
+  } catch (const std::exception &e) {
+    job.error = "Error generating code: " + std::string(e.what()) + "\n";
+    return false;
+  }
+}
+
+// Everything besides the source that decides what the objects look like
+static std::string codegen_flags(const Options &opts, const Runtime &runtime) {
+  std::string flags = "O2;pic";
+  flags += ";partition=" +
+           std::to_string(opts.incremental ? 1 : fns_per_partition);
+  if (opts.lto)
+    flags += opts.thin_lto ? ";lto=thin" : ";lto";
+  return flags + ";runtime=" + runtime.digest;
+}
+
+// A partition only has to be rebuilt when its own stmts change, when a
+// declaration every partition sees changes (enums, @module), when the
+// signature of a function it calls changes, or when the interface of a
+// module it uses changes.
+static std::string partition_key(const Unit &unit,
+                                 const std::vector<std::size_t> &stmts,
+                                 const Options &opts, const Runtime &runtime) {
+  const ProgramStmt *program = unit.program;
+  std::vector<bool> owned(program->size, false);
+  Encoder own;
+  for (std::size_t i : stmts) {
+    owned[i] = true;
+    own.node(program->stmts[i]);
+  }
+
+  Encoder context;
+  std::map<std::string, const FnStmt *> fns;
+  for (std::size_t i = 0; i < program->size; i++) {
+    Node::Stmt *stmt = program->stmts[i];
+    if (stmt->kind == NodeKind::fn_stmt)
+      fns[static_cast<FnStmt *>(stmt)->name] = static_cast<FnStmt *>(stmt);
+    else if (!owned[i])
+      context.node(stmt);
+  }
+
+  for (const std::string &callee : own.calls) {
+    auto it = fns.find(callee);
+    if (it == fns.end())
+      continue;
+    context.str(callee);
+    context.node(it->second->return_type);
+    context.u64(it->second->size);
+    for (std::size_t i = 0; i < it->second->size; i++)
+      context.node(it->second->args_type[i]);
+  }
+
+  return Cache::key({Cache::compiler_id(), codegen_flags(opts, runtime),
+                     llvm::sys::getDefaultTargetTriple(), own.out,
+                     context.out, unit.context});
+}
+
+// A module only has to be rebuilt when it changes or when the interface of
+// a module it uses does
+static std::string module_key(const Unit &unit, const Options &opts,
+                              const Runtime &runtime) {
+  return Cache::key({Cache::compiler_id(), codegen_flags(opts, runtime),
+                     llvm::sys::getDefaultTargetTriple(), unit.digest,
+                     unit.context});
+}
+
+// Named after the executable, so builds sharing a directory do not clash
+static std::string object_path(const std::string &dir, const Options &opts,
+                               std::size_t unit, std::size_t i) {
+  std::string name(llvm::sys::path::filename(opts.output));
+  return dir + "/" + name + "." + std::to_string(unit) + "." +
+         std::to_string(i) + ".o";
+}
+
+int Driver::generate(const Options &opts, const Runtime &runtime,
+                     const std::vector<Unit> &units, const std::string &dir,
+                     const std::string &cache_dir,
+                     std::vector<std::vector<std::string>> &objects,
+                     std::ostream &err) {
+  Trace::Scope scope(Trace::Kind::region, "codegen");
+  // Code generation, one object per partition of every unit
+  std::size_t fns = opts.incremental ? 1 : fns_per_partition;
+  std::vector<std::vector<std::vector<std::size_t>>> parts(units.size());
+  std::vector<PartitionJob> jobs;
+  objects.assign(units.size(), {});
+  for (std::size_t u = 0; u < units.size(); u++) {
+    parts[u] = Codegen::partition(units[u].program, fns);
+    for (std::size_t i = 0; i < parts[u].size(); i++) {
+      objects[u].push_back(object_path(dir, opts, units[u].id, i));
+      jobs.push_back({&units[u], &parts[u][i], objects[u].back(), "", "", ""});
+      if (opts.incremental && !cache_dir.empty())
+        jobs.back().key =
+            partition_key(units[u], parts[u][i], opts, runtime);
+    }
+  }
+
+  // Whatever codegen reports is kept with its partition, so it reaches
+  // `err` like everything else instead of the process's own stderr
+  std::vector<char> ok(jobs.size(), 0);
+  Thread::parallel_for(jobs.size(), opts.jobs, [&](std::size_t i) {
+    std::ostringstream diagnostics;
+    Codegen::ErrorSink sink(diagnostics);
+    ok[i] = compile_partition(jobs[i], opts, runtime, cache_dir);
+    jobs[i].error = diagnostics.str() + jobs[i].error;
+  });
+
+  int status = 0;
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    err << jobs[i].warnings << jobs[i].error;
+    if (!ok[i])
+      status = 3; // Code generation error
+  }
+  return status;
+}
+
+#ifndef ZURA2_RUNTIME_DIR
+#define ZURA2_RUNTIME_DIR "runtime"
+#endif
+
+bool Driver::load_runtime(const Options &opts, Runtime &runtime,
+                          std::ostream &err) {
+  std::string dir = resolve(opts, opts.runtime);
+  if (opts.runtime.empty()) {
+    const char *env = std::getenv("ZURA2_RUNTIME");
+    dir = env != nullptr && env[0] != '\0' ? env : ZURA2_RUNTIME_DIR;
+  }
+
+  llvm::SmallString<256> path(dir);
+  llvm::sys::path::append(path, "libzura2_runtime.a");
+  runtime.archive = std::string(path);
+  llvm::sys::path::remove_filename(path);
+  llvm::sys::path::append(path, "runtime.bc");
+
+  auto bitcode = llvm::MemoryBuffer::getFile(path);
+  if (!bitcode || !llvm::sys::fs::exists(runtime.archive)) {
+    err << "Could not find the runtime in " << dir
+        << ", build the zura2_runtime target or pass -runtime <dir>\n";
+    return false;
+  }
+  runtime.bitcode = std::string((*bitcode)->getBuffer());
+  runtime.digest = Cache::key({runtime.bitcode});
+  return true;
+}
+
+static std::string shell_quote(const std::string &s) {
+  std::string quoted = "'";
+  for (char c : s)
+    quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+  return quoted + "'";
+}
+
+bool Driver::link(const std::vector<std::string> &objects, const Options &opts,
+                  const Runtime &runtime, std::ostream &err) {
+  Trace::Scope scope(Trace::Kind::subprocess, "link", opts.output);
+  // Link the objects in partition order so the output is deterministic
+  std::string cmd;
+  if (!opts.workdir.empty())
+    cmd = "cd " + shell_quote(opts.workdir) + " && ";
+  cmd += "clang";
+  for (const std::string &object : objects)
+    cmd += " " + shell_quote(object);
+  cmd += " " + shell_quote(runtime.archive);
+  // -pthread for the pool behind @parallel loops
+  cmd += " -o " + shell_quote(opts.output) + " -fPIE -pthread";
+  if (opts.lto)
+    cmd += opts.thin_lto ? " -flto=thin" : " -flto";
+
+  // Capture what clang prints so it reaches whoever asked for the build
+  FILE *pipe = popen((cmd + " 2>&1").c_str(), "r");
+  if (!pipe) {
+    err << "Error linking with clang!" << std::endl;
+    return false;
+  }
+  char buffer[512];
+  std::size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    err.write(buffer, std::streamsize(n));
+
+  if (pclose(pipe) != 0) {
+    err << "Error linking with clang!" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// The executable also depends on the runtime archive it is linked with
+static std::string exe_key(const Runtime &runtime,
+                           const std::string &objects_key) {
+  auto buffer = llvm::MemoryBuffer::getFile(runtime.archive);
+  return Cache::key(
+      {objects_key, buffer ? (*buffer)->getBuffer() : llvm::StringRef()});
+}
+
+// Restores every partition object of a module from a previous build
+static bool restore_objects(const std::string &cache_dir,
+                            const std::string &key, const std::string &dir,
+                            const Options &opts, std::size_t unit,
+                            std::vector<std::string> &objects) {
+  std::string count;
+  if (!Cache::lookup_text(cache_dir, key, "objs", count))
+    return false;
+
+  std::size_t n = std::strtoull(count.c_str(), nullptr, 10);
+  objects.clear();
+  for (std::size_t i = 0; i < n; i++) {
+    objects.push_back(object_path(dir, opts, unit, i));
+    if (!Cache::lookup(cache_dir, key, std::to_string(i) + ".o",
+                       objects.back()))
+      return false;
+  }
+  return n > 0;
+}
+
+static int build_one(const Options &opts, std::ostream &out,
+                     std::ostream &err) {
+  Error::errors.clear(); // the thread may have served an earlier build
+  Trace::Scope scope(Trace::Kind::region, "build", opts.input);
+
+  Modules modules;
+  modules.push_back(std::make_unique<Module>());
+  modules[0]->path = resolve(opts, opts.input);
+  if (int status = load_modules(opts, modules, out, err))
+    return status;
+
+  if (opts.debug || opts.emit_ast) {
+    std::vector<std::size_t> all(modules.size());
+    std::iota(all.begin(), all.end(), 0);
+    if (int status = parse_modules(opts, modules, all, out))
+      return status;
+  }
+  for (const auto &m : modules) {
+    if (opts.debug)
+      m->program->debug(out);
+    if (opts.emit_ast && !emit_ast(*m, err))
+      return -1;
+  }
+
+  {
+    Trace::Scope check("typecheck");
+    // NOTE: Handle type checking here
+  }
+
+  Runtime runtime;
+  if (!load_runtime(opts, runtime, err))
+    return -1;
+
+  std::vector<Unit> units = units_of(modules);
+  std::string cache_dir = opts.cache ? Cache::directory() : "";
+  std::vector<std::string> keys;
+  std::string linked_key;
+  if (!cache_dir.empty()) {
+    Trace::Scope lookup("cache lookup", opts.output);
+    for (const Unit &unit : units)
+      keys.push_back(module_key(unit, opts, runtime));
+    linked_key = exe_key(runtime, Cache::key(keys));
+    if (Cache::lookup(cache_dir, linked_key, "exe", resolve(opts, opts.output))) {
+      namespace fs = llvm::sys::fs;
+      fs::setPermissions(resolve(opts, opts.output),
+                         fs::all_read | fs::all_exe | fs::owner_write);
+      if (Trace::memory())
+        count_memory(modules);
+      out << "Executable '" << opts.output << "' has been generated! (cached)"
+          << std::endl;
+      return 0;
+    }
+  }
+
+  // Saved objects go next to the executable
+  llvm::SmallString<128> dir(resolve(opts, "."));
+  llvm::StringRef parent = llvm::sys::path::parent_path(opts.output);
+  if (!parent.empty())
+    dir = resolve(opts, std::string(parent));
+  if (!opts.save) {
+    llvm::SmallString<128> prefix;
+    llvm::sys::path::system_temp_directory(true, prefix);
+    llvm::sys::path::append(prefix, "zura2");
+    if (auto EC = llvm::sys::fs::createUniqueDirectory(prefix, dir)) {
+      err << "Could not create a temporary directory: " << EC.message()
+          << "\n";
+      return 4;
+    }
+  }
+
+  // Only modules whose own objects are not cached get compiled
+  std::vector<std::vector<std::string>> objects(units.size());
+  std::vector<Unit> stale;
+  for (std::size_t i = 0; i < units.size(); i++) {
+    bool restored = false;
+    if (!cache_dir.empty()) {
+      Trace::Scope restore("cache lookup", modules[i]->path);
+      restored = restore_objects(cache_dir, keys[i], std::string(dir), opts,
+                                 i, objects[i]);
+    }
+    if (!restored)
+      stale.push_back(units[i]);
+  }
+
+  // Modules loaded from their interface are only parsed now that their
+  // code is needed
+  std::vector<std::size_t> which;
+  for (const Unit &unit : stale)
+    which.push_back(unit.id);
+  int status = parse_modules(opts, modules, which, out);
+
+  std::vector<std::vector<std::string>> compiled;
+  if (status == 0) {
+    for (Unit &unit : stale)
+      unit.program = modules[unit.id]->program;
+    status = generate(opts, runtime, stale, std::string(dir), cache_dir,
+                      compiled, err);
+    for (std::size_t i = 0; i < stale.size(); i++)
+      objects[stale[i].id] = std::move(compiled[i]);
+  }
+
+  // Incremental builds already cached every partition under its own key
+  if (status == 0 && !cache_dir.empty() && !opts.incremental) {
+    Trace::Scope store("cache store");
+    for (const Unit &unit : stale) {
+      const std::string &key = keys[unit.id];
+      const std::vector<std::string> &objs = objects[unit.id];
+      bool stored = true;
+      for (std::size_t i = 0; i < objs.size() && stored; i++)
+        stored = Cache::store(cache_dir, key, std::to_string(i) + ".o", objs[i]);
+      // The count goes in last, it is what marks the entry as complete
+      if (stored)
+        Cache::store_text(cache_dir, key, "objs", std::to_string(objs.size()));
+    }
+  }
+
+  std::vector<std::string> all;
+  for (const auto &objs : objects)
+    all.insert(all.end(), objs.begin(), objs.end());
+
+  if (status == 0 && !link(all, opts, runtime, err))
+    status = -1;
+
+  if (status == 0 && !cache_dir.empty()) {
+    Trace::Scope store("cache store", opts.output);
+    Cache::store(cache_dir, linked_key, "exe", resolve(opts, opts.output));
+    if (opts.evict)
+      Cache::evict(cache_dir, Cache::size_limit());
+  }
+
+  if (Trace::memory())
+    count_memory(modules);
+
+  if (!opts.save) {
+    for (const std::string &object : all)
+      llvm::sys::fs::remove(object);
+    llvm::sys::fs::remove(dir);
+  }
+
+  if (status == 0)
+    out << "Executable '" << opts.output << "' has been generated!"
+        << std::endl;
+  return status;
+}
+
+// `dir/name` when opts.output names a directory, opts.output otherwise
+static std::string output_for(const Options &opts, const std::string &input,
+                              std::ostream &err, bool &ok) {
+  const std::string &output = opts.output;
+  ok = true;
+  if (!opts.batch && !llvm::sys::path::is_separator(output.back()) &&
+      !llvm::sys::fs::is_directory(resolve(opts, output)))
+    return output;
+
+  if (auto EC = llvm::sys::fs::create_directories(resolve(opts, output))) {
+    err << "Could not create " << output << ": " << EC.message() << "\n";
+    ok = false;
+  }
+  llvm::SmallString<256> path(output);
+  llvm::sys::path::append(
+      path, input == "-" ? "my_program" : llvm::sys::path::stem(input));
+  return std::string(path);
+}
+
+// Every input is built like a build of its own, up to opts.jobs at a time
+static int build_batch(const Options &opts, std::ostream &out,
+                       std::ostream &err) {
+  std::vector<Options> files;
+  std::map<std::string, std::string> taken; // executable -> input
+  for (const std::string &input : opts.inputs) {
+    Options file = opts;
+    bool ok;
+    file.output = output_for(opts, input, err, ok);
+    if (!ok)
+      return -1;
+    auto [it, inserted] = taken.emplace(file.output, input);
+    if (!inserted) {
+      err << input << " and " << it->second << " would both be built into "
+          << file.output << "\n";
+      return -1;
+    }
+    file.input = input;
+    file.inputs = {input};
+    file.batch = false;
+    file.jobs = 1;
+    file.evict = false;
+    files.push_back(std::move(file));
+  }
+
+  struct Result {
+    bool done = false;
+    int status = 0;
+    std::string out, err;
+  };
+  std::vector<Result> results(files.size());
+  std::mutex lock;
+  std::size_t printed = 0;
+
+  Thread::parallel_for(files.size(), opts.jobs, [&](std::size_t i) {
+    std::ostringstream file_out, file_err;
+    int status = build_one(files[i], file_out, file_err);
+
+    // Keep the output in input order, without waiting for the whole batch
+    std::lock_guard<std::mutex> guard(lock);
+    results[i] = {true, status, file_out.str(), file_err.str()};
+    for (; printed < results.size() && results[printed].done; printed++) {
+      Result &r = results[printed];
+      out << r.out << std::flush;
+      if (!r.err.empty())
+        err << files[printed].input << ":\n" << r.err << std::flush;
+      r.out.clear();
+      r.err.clear();
+    }
+  });
+
+  int status = 0;
+  std::size_t built = 0;
+  for (const Result &r : results) {
+    if (r.status == 0)
+      built++;
+    else if (status == 0)
+      status = r.status;
+  }
+
+  std::string cache_dir = opts.cache ? Cache::directory() : "";
+  if (!cache_dir.empty() && opts.evict)
+    Cache::evict(cache_dir, Cache::size_limit());
+
+  out << "Built " << built << " of " << files.size() << " files" << std::endl;
+  return status;
+}
+
+int Driver::run(const Options &opts) {
+  if (opts.time_report || opts.mem_report || !opts.trace.empty())
+    Trace::start(opts.mem_report);
+  int status = build(opts);
+  if (opts.time_report)
+    Trace::report(std::cerr);
+  if (opts.mem_report)
+    Trace::memory_report(std::cerr);
+  if (!opts.trace.empty() && !Trace::write(opts.trace, std::cerr) &&
+      status == 0)
+    status = -1;
+  return status;
+}
+
+int Driver::build(const Options &opts, std::ostream &out, std::ostream &err) {
+  if (opts.batch)
+    return build_batch(opts, out, err);
+
+  Options one = opts;
+  bool ok;
+  one.output = output_for(opts, opts.input, err, ok);
+  return ok ? build_one(one, out, err) : -1;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../ast/ast.hpp"
+#include "source.hpp"
+
+/*
+ * zura2 build <file>... [flags]
+ *
+ *   <file>   the root module, - reads it from stdin
+ *   -o <path>  the executable, my_program by default. When it ends in /
+ *              or is a directory, the executable is named after the file.
+ *   -manifest <list>  build every file listed in <list>, one per line.
+ *                     Blank lines and lines starting with # are skipped,
+ *                     relative paths are relative to the list.
+ *   -j <n>   parse chunks and compile code partitions on n threads
+ *   -save    keep the intermediate .ll and .o files next to the output
+ *   -debug   dump the parsed AST
+ *   -no-cache  always rebuild, see cache/cache.hpp for the build cache
+ *   -incremental  one partition per function, each cached on its own, so
+ *                 only edited functions are recompiled
+ *   -lto     emit bitcode instead of objects and link with -flto
+ *   -lto=thin  the same with a ThinLTO summary, linked with -flto=thin
+ *   -runtime <dir>  where libzura2_runtime.a and runtime.bc are, see
+ *                   Runtime below
+ *   -emit-ast  write <module>.zast next to every module, see ast_file.hpp
+ *   --time-report  print wall and CPU time per phase, LLVM pass and
+ *                  function to stderr once the build is done
+ *   --trace=<file>  write the same timings as a Chrome trace, see
+ *                   trace/trace.hpp
+ *   --mem-report  print peak RSS and heap traffic per phase, arena, token
+ *                 and AST sizes and IR instruction counts to stderr
+ *
+ * Every module the file @uses is built with it, see driver/module.hpp.
+ *
+ * Given several files, or a manifest, each one is built into its own
+ * program, named after the file, in the -o directory (the current one by
+ * default). Up to -j files are built at once, each with its own LLVM
+ * contexts and arenas. The output of every file is printed in order, as
+ * soon as it and the ones before it are done. Its diagnostics, those of
+ * code generation included, follow under its name.
+ */
+
+struct ProgramStmt;
+
+namespace Driver {
+struct Options {
+  std::string input;
+  std::vector<std::string> inputs; // every file given, input is the first
+  bool batch = false; // several inputs or a manifest, see above
+  std::string output = "my_program";
+  std::size_t jobs = 1;
+  bool save = false;
+  bool debug = false;
+  bool cache = true;
+  bool incremental = false;
+  bool lto = false;
+  bool thin_lto = false; // -lto=thin, lto is set as well
+  std::string runtime;   // -runtime, empty for the default
+  bool emit_ast = false;
+  bool time_report = false;
+  bool mem_report = false;
+  std::string trace; // where --trace writes, empty for no trace
+  // Directory relative paths are resolved against, empty for the current one
+  std::string workdir;
+  // Batch builds trim the cache once at the end rather than after each file
+  bool evict = true;
+};
+
+// One module as code generation sees it
+struct Unit {
+  const ProgramStmt *program;
+  std::vector<const Node::Stmt *> imports; // pub declarations of its deps
+  std::string context; // interfaces of its deps, part of its cache keys
+  std::string digest;  // hash of its own AST, see Module::digest
+  std::size_t id;      // names its objects, unique within a build
+};
+
+// The runtime library every program is linked with, libs/ built by the
+// zura2_runtime target. The bitcode is linked into every module before it
+// is optimized so print loops can inline its helpers, the archive is for
+// the final link. It is looked for in -runtime, then $ZURA2_RUNTIME, then
+// the build directory the compiler was built in.
+struct Runtime {
+  std::string archive; // path of libzura2_runtime.a
+  std::string bitcode; // contents of runtime.bc
+  std::string digest;  // of the bitcode, part of every cache key
+};
+
+// How many functions go into one codegen partition. This is fixed so the
+// generated objects do not depend on the -j value.
+inline constexpr std::size_t fns_per_partition = 64;
+
+// A -j value: a whole positive number, nothing before or after it
+bool parse_jobs(const std::string &text, std::size_t &jobs);
+
+// Diagnostics go to `err` and progress to `out`, so a server can hand them
+// back to the client instead of printing them itself
+bool parse_args(int argc, char *argv[], Options &opts,
+                std::ostream &err = std::cerr);
+int build(const Options &opts, std::ostream &out = std::cout,
+          std::ostream &err = std::cerr);
+// build() for the process the user started, which also takes care of
+// --time-report, --trace and --mem-report. A server only ever calls build().
+int run(const Options &opts);
+
+// The pieces of build() for callers that keep their own front end state,
+// besides read_file in source.hpp
+bool load_runtime(const Options &opts, Runtime &runtime, std::ostream &err);
+// Lowers every unit into one object per partition, written to `dir`. All
+// partitions of all units are compiled together on opts.jobs threads.
+int generate(const Options &opts, const Runtime &runtime,
+             const std::vector<Unit> &units, const std::string &dir,
+             const std::string &cache_dir,
+             std::vector<std::vector<std::string>> &objects,
+             std::ostream &err);
+bool link(const std::vector<std::string> &objects, const Options &opts,
+          const Runtime &runtime, std::ostream &err);
+}; // namespace Driver
@@ -0,0 +1,261 @@
+#include "interface.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <llvm/Support/Endian.h>
+#include <vector>
+
+#include "../ast/stmt.hpp"
+#include "../ast/type.hpp"
+
+using namespace Allocator;
+using namespace Driver;
+
+namespace {
+using u32 = llvm::support::ulittle32_t;
+
+constexpr char magic[4] = {'Z', 'U', 'I', 'F'};
+constexpr std::uint32_t version = 4;
+
+struct Str {
+  u32 offset; // into the string table
+  u32 size;
+};
+
+struct Table {
+  u32 offset; // from the start of the file
+  u32 count;
+};
+
+struct SymbolEntry {
+  Str name;
+  u32 kind;
+  u32 is_pub;
+};
+
+// A function takes its return type from `type` and its parameter types from
+// `items`. An enum only uses `items`, for its values.
+struct ExportEntry {
+  Str name;
+  u32 kind;
+  Str type;
+  u32 first; // index into the refs table
+  u32 count;
+};
+
+struct Header {
+  char magic[4];
+  u32 version;
+  u32 size;
+  Str digest;
+  Str interface;
+  Table symbols, exports, uses, calls, refs, strings;
+};
+
+static_assert(alignof(Header) == 1 && alignof(ExportEntry) == 1,
+              "entries are read in place from any offset");
+
+struct Writer {
+  std::string strings;
+  std::vector<SymbolEntry> symbols;
+  std::vector<ExportEntry> exports;
+  std::vector<Str> uses, calls, refs;
+
+  Str str(const std::string &s) {
+    Str ref;
+    ref.offset = std::uint32_t(strings.size());
+    ref.size = std::uint32_t(s.size());
+    strings += s;
+    return ref;
+  }
+};
+
+template <typename T>
+void append(std::string &out, Table &table, const std::vector<T> &items) {
+  table.offset = std::uint32_t(out.size());
+  table.count = std::uint32_t(items.size());
+  out.append(reinterpret_cast<const char *>(items.data()),
+             items.size() * sizeof(T));
+}
+
+// Points `items` at a table after checking it lies inside the file
+template <typename T>
+bool view(llvm::StringRef data, const Table &table, const T *&items) {
+  if (std::uint64_t(table.offset) + std::uint64_t(table.count) * sizeof(T) >
+      data.size())
+    return false;
+  items = reinterpret_cast<const T *>(data.data() + table.offset);
+  return true;
+}
+
+struct Reader {
+  llvm::StringRef strings;
+  bool ok = true;
+
+  std::string str(const Str &ref) {
+    if (std::uint64_t(ref.offset) + ref.size > strings.size()) {
+      ok = false;
+      return "";
+    }
+    return strings.substr(ref.offset, ref.size).str();
+  }
+};
+
+// An export read back before any node is created, so a bad file can still
+// be rejected without touching the module
+struct Export {
+  std::string name;
+  NodeKind kind;
+  std::string type;
+  std::vector<std::string> items;
+};
+} // namespace
+
+static const std::string *type_name(const Node::Type *type) {
+  if (type == nullptr || type->kind != NodeKind::symbol_type)
+    return nullptr;
+  return &static_cast<const SymbolType *>(type)->name;
+}
+
+std::string Driver::write_interface(const Module &m) {
+  Writer w;
+  for (const Symbol &symbol : m.symbols) {
+    SymbolEntry entry;
+    entry.name = w.str(symbol.name);
+    entry.kind = std::uint32_t(symbol.kind);
+    entry.is_pub = std::uint32_t(symbol.is_pub);
+    w.symbols.push_back(entry);
+  }
+  for (const std::string &use : m.uses)
+    w.uses.push_back(w.str(use));
+  for (const std::string &callee : m.calls)
+    w.calls.push_back(w.str(callee));
+
+  for (const Node::Stmt *stmt : m.exports) {
+    ExportEntry entry;
+    entry.kind = std::uint32_t(stmt->kind);
+    entry.first = std::uint32_t(w.refs.size());
+    if (stmt->kind == NodeKind::fn_stmt) {
+      auto *fn = static_cast<const FnStmt *>(stmt);
+      const std::string *ret = type_name(fn->return_type);
+      if (ret == nullptr)
+        return "";
+      entry.name = w.str(fn->name);
+      entry.type = w.str(*ret);
+      for (std::size_t i = 0; i < fn->size; i++) {
+        const std::string *arg = type_name(fn->args_type[i]);
+        if (arg == nullptr)
+          return "";
+        w.refs.push_back(w.str(*arg));
+      }
+    } else {
+      auto *en = static_cast<const EnumStmt *>(stmt);
+      entry.name = w.str(en->name);
+      entry.type = w.str("");
+      for (std::size_t i = 0; i < en->size; i++)
+        w.refs.push_back(w.str(en->enums[i]));
+    }
+    entry.count = std::uint32_t(w.refs.size()) - entry.first;
+    w.exports.push_back(entry);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.digest = w.str(m.digest);
+  header.interface = w.str(m.interface);
+
+  std::string out(sizeof(Header), '\0');
+  append(out, header.symbols, w.symbols);
+  append(out, header.exports, w.exports);
+  append(out, header.uses, w.uses);
+  append(out, header.calls, w.calls);
+  append(out, header.refs, w.refs);
+  header.strings.offset = std::uint32_t(out.size());
+  header.strings.count = std::uint32_t(w.strings.size());
+  out += w.strings;
+  header.size = std::uint32_t(out.size());
+  std::memcpy(out.data(), &header, sizeof(Header));
+  return out;
+}
+
+bool Driver::read_interface(llvm::StringRef data, Module &m) {
+  if (data.size() < sizeof(Header))
+    return false;
+  auto *header = reinterpret_cast<const Header *>(data.data());
+  if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+      header->version != version || header->size != data.size())
+    return false;
+
+  const SymbolEntry *symbols;
+  const ExportEntry *exports;
+  const Str *uses, *calls, *refs;
+  const char *strings;
+  if (!view(data, header->symbols, symbols) ||
+      !view(data, header->exports, exports) ||
+      !view(data, header->uses, uses) || !view(data, header->calls, calls) ||
+      !view(data, header->refs, refs) ||
+      !view(data, header->strings, strings))
+    return false;
+
+  Reader r{llvm::StringRef(strings, header->strings.count)};
+  std::string digest = r.str(header->digest);
+  std::string interface = r.str(header->interface);
+
+  std::vector<Symbol> syms;
+  for (std::size_t i = 0; i < header->symbols.count; i++)
+    syms.push_back({r.str(symbols[i].name),
+                    NodeKind(std::uint32_t(symbols[i].kind)),
+                    symbols[i].is_pub != 0});
+
+  std::vector<std::string> use_paths, callees;
+  for (std::size_t i = 0; i < header->uses.count; i++)
+    use_paths.push_back(r.str(uses[i]));
+  for (std::size_t i = 0; i < header->calls.count; i++)
+    callees.push_back(r.str(calls[i]));
+
+  std::vector<Export> exps;
+  for (std::size_t i = 0; i < header->exports.count; i++) {
+    const ExportEntry &entry = exports[i];
+    NodeKind kind = NodeKind(std::uint32_t(entry.kind));
+    if ((kind != NodeKind::fn_stmt && kind != NodeKind::enum_stmt) ||
+        std::uint64_t(entry.first) + entry.count > header->refs.count)
+      return false;
+
+    Export e{r.str(entry.name), kind, r.str(entry.type), {}};
+    for (std::size_t j = 0; j < entry.count; j++)
+      e.items.push_back(r.str(refs[entry.first + j]));
+    exps.push_back(std::move(e));
+  }
+  if (!r.ok)
+    return false;
+
+  // Declarations are all importers need, so functions come back without
+  // parameter names or bodies
+  if (!m.arena)
+    m.arena = std::make_unique<ArenaAllocator>(1024);
+  ArenaAllocator &arena = *m.arena;
+  m.exports.clear();
+  for (const Export &e : exps) {
+    if (e.kind == NodeKind::fn_stmt) {
+      std::vector<std::pair<std::string, Node::Type *>> params;
+      for (const std::string &type : e.items)
+        params.push_back({"", arena.emplace<SymbolType>(type)});
+      auto *ret = arena.emplace<SymbolType>(e.type);
+      auto *fn = arena.emplace<FnStmt>(e.name, ret, params, nullptr, arena);
+      fn->is_pub = true;
+      m.exports.push_back(fn);
+    } else {
+      auto *en = arena.emplace<EnumStmt>(e.name, e.items, arena);
+      en->is_pub = true;
+      m.exports.push_back(en);
+    }
+  }
+
+  m.digest = std::move(digest);
+  m.interface = std::move(interface);
+  m.symbols = std::move(syms);
+  m.uses = std::move(use_paths);
+  m.calls = std::move(callees);
+  return true;
+}
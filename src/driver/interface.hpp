@@ -0,0 +1,34 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <string>
+
+#include "module.hpp"
+
+/*
+ * Binary module interfaces
+ *
+ * Once a module has been parsed, everything the other modules need from it
+ * is written to the build cache, keyed by its source:
+ *
+ *   header    magic, version, file size and where every table starts
+ *   symbols   its top level functions and enums, with their pub flag
+ *   exports   pub function signatures as SymbolType names, pub enum values
+ *   uses      @use paths as written
+ *   calls     callees that some other module has to define
+ *   strings   the bytes of every name above, referenced by offset and size
+ *
+ * Every field is a little endian u32 at a fixed offset, so the mapped file
+ * is read in place instead of being decoded. A module whose source has an
+ * interface in the cache is not lexed or parsed unless its code has to be
+ * generated.
+ */
+
+namespace Driver {
+// Empty when the module has something the format cannot describe
+std::string write_interface(const Module &m);
+
+// Fills the summary and exports of `m`. False, leaving `m` untouched, when
+// `data` is not an interface of this version.
+bool read_interface(llvm::StringRef data, Module &m);
+}; // namespace Driver
@@ -0,0 +1,466 @@
+#include "module.hpp"
+
+#include <algorithm>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "../ast/encode.hpp"
+#include "../ast/stmt.hpp"
+#include "../ast/type.hpp"
+#include "../cache/cache.hpp"
+#include "../error/error.hpp"
+#include "../lexer/lexer.hpp"
+#include "../parser/parser.hpp"
+#include "../thread/pool.hpp"
+#include "../trace/trace.hpp"
+#include "ast_file.hpp"
+#include "interface.hpp"
+
+using namespace Allocator;
+using namespace Driver;
+
+static std::string normalize(const std::string &path) {
+  llvm::SmallString<256> clean(path);
+  llvm::sys::path::remove_dots(clean, true);
+  return std::string(clean);
+}
+
+// `@use name` is name.zu next to the user, a quoted path is relative to it
+static std::string use_path(const Module &user, const std::string &use) {
+  std::string file = use;
+  if (llvm::sys::path::extension(file).empty())
+    file += ".zu";
+  if (llvm::sys::path::is_absolute(file))
+    return normalize(file);
+
+  llvm::SmallString<256> path(llvm::sys::path::parent_path(user.path));
+  llvm::sys::path::append(path, file);
+  return normalize(std::string(path));
+}
+
+// Lexes and parses one module on the calling thread, unless a serialized
+// AST of the same source is around. Diagnostics end up in `errors` rather
+// than in this thread's Error::errors.
+static int parse_module(Module &m, std::size_t jobs,
+                        const std::string &cache_dir,
+                        std::vector<std::string> &errors) {
+  // A module loaded from its interface already has its exports in here
+  if (!m.arena)
+    m.arena = std::make_unique<ArenaAllocator>(1024);
+  if (load_ast(m, cache_dir, jobs))
+    return 0;
+
+  std::vector<std::string> saved = std::move(Error::errors);
+  std::string saved_file = Error::file;
+  Error::errors.clear();
+  Error::file = m.path;
+
+  Lexer::lexer lx;
+  lx.init_lexer(&lx, m.source.c_str());
+  std::vector<Lexer::Token> tks;
+  {
+    Trace::Scope scope("lex", m.path);
+    while (true) {
+      Lexer::Token tk = lx.scan_token();
+      tks.push_back(tk);
+      if (tk.kind == Lexer::Kind::eof)
+        break;
+    }
+  }
+  if (Trace::memory()) {
+    Trace::count("tokens", tks.size());
+    Trace::count("token vector capacity", tks.capacity());
+    Trace::count("token vector bytes", tks.capacity() * sizeof(Lexer::Token));
+  }
+
+  int status = 0;
+  if (!Error::errors.empty()) {
+    status = 1; // Lexical Error
+  } else {
+    m.program = static_cast<ProgramStmt *>(
+        Parser::parse_parallel(std::move(tks), *m.arena, m.chunk_arenas, jobs));
+    if (!Error::errors.empty())
+      status = 2; // Parser Error
+    else
+      store_ast(m, cache_dir);
+  }
+
+  errors = std::move(Error::errors);
+  Error::errors = std::move(saved);
+  Error::file = saved_file;
+  return status;
+}
+
+// Pub functions only export their signature, parameter names do not matter
+// to the modules that call them
+static void export_stmts(Module &m) {
+  Encoder e;
+  m.exports.clear();
+  for (std::size_t i = 0; i < m.program->size; i++) {
+    const Node::Stmt *stmt = m.program->stmts[i];
+    if (stmt->kind == NodeKind::fn_stmt &&
+        static_cast<const FnStmt *>(stmt)->is_pub) {
+      auto *fn = static_cast<const FnStmt *>(stmt);
+      e.tag(fn->kind);
+      e.str(fn->name);
+      e.node(fn->return_type);
+      e.u64(fn->size);
+      for (std::size_t j = 0; j < fn->size; j++)
+        e.node(fn->args_type[j]);
+    } else if (stmt->kind == NodeKind::enum_stmt &&
+               static_cast<const EnumStmt *>(stmt)->is_pub) {
+      e.node(stmt);
+    } else {
+      continue;
+    }
+    m.exports.push_back(stmt);
+  }
+  m.interface = std::move(e.out);
+}
+
+// Everything the build needs from a parsed module besides its code
+static void summarize(Module &m) {
+  Trace::Scope scope("summarize", m.path);
+  Encoder e;
+  e.node(m.program);
+  m.digest = Cache::key({e.out});
+
+  std::set<std::string> own;
+  m.uses.clear();
+  m.symbols.clear();
+  for (std::size_t i = 0; i < m.program->size; i++) {
+    const Node::Stmt *stmt = m.program->stmts[i];
+    if (stmt->kind == NodeKind::use_stmt) {
+      m.uses.push_back(static_cast<const UseStmt *>(stmt)->path);
+    } else if (stmt->kind == NodeKind::fn_stmt) {
+      auto *fn = static_cast<const FnStmt *>(stmt);
+      m.symbols.push_back({fn->name, fn->kind, fn->is_pub});
+      own.insert(fn->name);
+    } else if (stmt->kind == NodeKind::enum_stmt) {
+      auto *en = static_cast<const EnumStmt *>(stmt);
+      m.symbols.push_back({en->name, en->kind, en->is_pub});
+    }
+  }
+
+  m.calls.clear();
+  for (const std::string &callee : e.calls) {
+    if (!own.count(callee))
+      m.calls.push_back(callee);
+  }
+  export_stmts(m);
+}
+
+// The interface only depends on the source and on the compiler reading it
+static std::string interface_key(const Module &m) {
+  return Cache::key({Cache::compiler_id(), "interface", m.source.text()});
+}
+
+// Reads one module and fills in its summary, from `previous` when its source
+// did not change, from its interface file when the cache has one, and by
+// parsing it otherwise. A module that is `kept` for the next build reads a
+// copy of its source, which that build compares against.
+static int load_module(Module &m, std::size_t jobs,
+                       const std::string &cache_dir,
+                       std::vector<std::string> &errors, std::string &failure,
+                       Module *previous, bool kept) {
+  std::ostringstream err;
+  {
+    Trace::Scope scope("read", m.path);
+    if (!read_file(m.path, m.source, err, kept)) {
+      failure = err.str();
+      return -1;
+    }
+  }
+
+  if (previous != nullptr && !previous->digest.empty() &&
+      previous->source.text() == m.source.text()) {
+    m = std::move(*previous);
+    m.deps.clear();
+    previous->digest.clear();
+    previous->program = nullptr;
+    return 0;
+  }
+
+  if (!cache_dir.empty()) {
+    Trace::Scope scope("load interface", m.path);
+    auto buffer = Cache::map(cache_dir, interface_key(m), "zui");
+    if (buffer && read_interface(buffer->getBuffer(), m))
+      return 0;
+  }
+
+  if (int status = parse_module(m, jobs, cache_dir, errors))
+    return status;
+  summarize(m);
+
+  if (!cache_dir.empty()) {
+    Trace::Scope scope("store interface", m.path);
+    std::string data = write_interface(m);
+    if (!data.empty())
+      Cache::store_text(cache_dir, interface_key(m), "zui", data);
+  }
+  return 0;
+}
+
+static bool find_cycle(const Modules &modules, std::size_t i,
+                       std::vector<int> &state, std::vector<std::size_t> &path,
+                       std::ostream &err) {
+  state[i] = 1; // on the current path
+  path.push_back(i);
+  for (std::size_t dep : modules[i]->deps) {
+    if (state[dep] == 1) {
+      err << "Circular @use: ";
+      auto start = std::find(path.begin(), path.end(), dep);
+      for (auto it = start; it != path.end(); it++)
+        err << modules[*it]->path << " -> ";
+      err << modules[dep]->path << "\n";
+      return true;
+    }
+    if (state[dep] == 0 && find_cycle(modules, dep, state, path, err))
+      return true;
+  }
+  path.pop_back();
+  state[i] = 2; // done
+  return false;
+}
+
+// Every module shares one symbol namespace once linked
+static bool check_duplicates(const Modules &modules, std::ostream &err) {
+  std::map<std::string, std::size_t> owner;
+  bool ok = true;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    for (const Symbol &symbol : modules[i]->symbols) {
+      auto [it, inserted] = owner.emplace(symbol.name, i);
+      if (!inserted && it->second != i) {
+        err << "'" << symbol.name << "' is defined in both "
+            << modules[it->second]->path << " and " << modules[i]->path
+            << "\n";
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+// A module sees its own functions and the pub ones of the modules it uses.
+// Calls to anything else that some other module defines are reported here,
+// where we still know which module that is.
+static bool check_visibility(const Modules &modules, std::ostream &err) {
+  std::map<std::string, std::pair<std::size_t, bool>> defined;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    for (const Symbol &symbol : modules[i]->symbols) {
+      if (symbol.kind == NodeKind::fn_stmt)
+        defined.emplace(symbol.name, std::make_pair(i, symbol.is_pub));
+    }
+  }
+
+  bool ok = true;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    std::set<std::string> visible;
+    for (std::size_t dep : modules[i]->deps) {
+      for (const Node::Stmt *stmt : modules[dep]->exports) {
+        if (stmt->kind == NodeKind::fn_stmt)
+          visible.insert(static_cast<const FnStmt *>(stmt)->name);
+      }
+    }
+
+    for (const std::string &callee : modules[i]->calls) {
+      auto it = defined.find(callee);
+      if (it == defined.end() || it->second.first == i ||
+          visible.count(callee))
+        continue;
+
+      err << modules[i]->path << ": '" << callee << "' is defined in "
+          << modules[it->second.first]->path;
+      if (it->second.second)
+        err << ", which this module does not @use\n";
+      else
+        err << " but is not pub\n";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+int Driver::load_modules(const Options &opts, Modules &modules,
+                         std::ostream &out, std::ostream &err,
+                         Modules *previous) {
+  Trace::Scope scope(Trace::Kind::region, "load modules");
+  std::map<std::string, std::size_t> index;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    modules[i]->path = normalize(modules[i]->path);
+    index[modules[i]->path] = i;
+  }
+
+  std::map<std::string, Module *> loaded;
+  if (previous != nullptr) {
+    for (auto &m : *previous) {
+      if (m != nullptr)
+        loaded[m->path] = m.get();
+    }
+  }
+  std::string cache_dir = opts.cache ? Cache::directory() : "";
+
+  std::vector<std::vector<std::string>> errors;
+  std::vector<std::string> failures;
+  std::vector<int> status;
+  // The module whose @use first reached each one, for its read errors. The
+  // modules we were given were reached by none.
+  const std::size_t none = std::size_t(-1);
+  std::vector<std::size_t> used_by(modules.size(), none);
+
+  // Each wave is every module first reached by the previous one
+  std::size_t begin = 0;
+  while (begin < modules.size()) {
+    std::size_t end = modules.size();
+    errors.resize(end);
+    failures.resize(end);
+    status.resize(end);
+
+    Thread::parallel_for(end - begin, opts.jobs, [&](std::size_t k) {
+      std::size_t i = begin + k;
+      if (modules[i]->program != nullptr) {
+        summarize(*modules[i]); // handed to us already parsed
+        return;
+      }
+      auto it = loaded.find(modules[i]->path);
+      status[i] = load_module(*modules[i], opts.jobs, cache_dir, errors[i],
+                              failures[i],
+                              it == loaded.end() ? nullptr : it->second,
+                              previous != nullptr);
+    });
+
+    for (std::size_t i = begin; i < end; i++) {
+      if (status[i] != 0)
+        continue;
+      for (const std::string &use : modules[i]->uses) {
+        std::string path = use_path(*modules[i], use);
+        auto [it, inserted] = index.emplace(path, modules.size());
+        if (inserted) {
+          modules.push_back(std::make_unique<Module>());
+          modules.back()->path = path;
+          used_by.push_back(i);
+        }
+        modules[i]->deps.push_back(it->second);
+      }
+    }
+    begin = end;
+  }
+
+  // Diagnostics in module order, so they do not depend on -j
+  int result = 0;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    if (status[i] == 0)
+      continue;
+    if (!failures[i].empty() && used_by[i] != none)
+      err << modules[used_by[i]]->path << ": ";
+    err << failures[i];
+    Error::errors = std::move(errors[i]);
+    Error::report_error(out);
+    Error::errors.clear();
+    if (result == 0)
+      result = status[i];
+  }
+  if (result != 0)
+    return result;
+
+  std::vector<int> state(modules.size(), 0);
+  std::vector<std::size_t> path;
+  if (find_cycle(modules, 0, state, path, err) ||
+      !check_duplicates(modules, err))
+    return 2;
+
+  return check_visibility(modules, err) ? 0 : 2;
+}
+
+int Driver::parse_modules(const Options &opts, Modules &modules,
+                          const std::vector<std::size_t> &which,
+                          std::ostream &out) {
+  Trace::Scope scope(Trace::Kind::region, "parse modules");
+  std::string cache_dir = opts.cache ? Cache::directory() : "";
+  std::vector<std::vector<std::string>> errors(which.size());
+  std::vector<int> status(which.size(), 0);
+  Thread::parallel_for(which.size(), opts.jobs, [&](std::size_t k) {
+    if (modules[which[k]]->program == nullptr)
+      status[k] = parse_module(*modules[which[k]], opts.jobs, cache_dir,
+                               errors[k]);
+  });
+
+  int result = 0;
+  for (std::size_t k = 0; k < which.size(); k++) {
+    if (status[k] == 0)
+      continue;
+    Error::errors = std::move(errors[k]);
+    Error::report_error(out);
+    Error::errors.clear();
+    if (result == 0)
+      result = status[k];
+  }
+  return result;
+}
+
+std::vector<Unit> Driver::units_of(const Modules &modules) {
+  std::vector<Unit> units;
+  for (std::size_t i = 0; i < modules.size(); i++) {
+    Unit unit{modules[i]->program, {}, "", modules[i]->digest, i};
+    Encoder context;
+    for (std::size_t dep : modules[i]->deps) {
+      const Module &d = *modules[dep];
+      unit.imports.insert(unit.imports.end(), d.exports.begin(),
+                          d.exports.end());
+      context.str(d.interface);
+    }
+    unit.context = std::move(context.out);
+    units.push_back(std::move(unit));
+  }
+  return units;
+}
+
+// Names of NodeKind, in declaration order
+static const char *const kind_names[] = {
+    "symbol_type", "program",     "number",      "string",
+    "array",       "ident",       "binary",      "unary",
+    "group",       "call",        "builtin",     "index",
+    "slice",       "range",       "assign",      "member",
+    "dereference", "address",     "cast",        "size_of",
+    "alloc",       "free",        "memcpy",      "prefix",
+    "module_stmt", "use_stmt",    "expr_stmt",   "var_stmt",
+    "return_stmt", "fn_stmt",     "block_stmt",  "print_stmt",
+    "loop_stmt",   "if_stmt",     "struct_stmt", "enum_stmt",
+};
+static constexpr std::size_t kind_count =
+    sizeof(kind_names) / sizeof(kind_names[0]);
+static_assert(kind_count == std::size_t(NodeKind::enum_stmt) + 1,
+              "every NodeKind needs a name");
+
+void Driver::count_memory(const Modules &modules) {
+  std::size_t kinds[kind_count] = {};
+  for (const auto &m : modules) {
+    Trace::count("source bytes", m->source.size());
+    std::size_t blocks = 0, bytes = 0;
+    if (m->arena) {
+      blocks += m->arena->blocks();
+      bytes += m->arena->capacity();
+    }
+    for (const auto &arena : m->chunk_arenas) {
+      blocks += arena->blocks();
+      bytes += arena->capacity();
+    }
+    Trace::count("arena blocks", blocks);
+    Trace::count("arena bytes", bytes);
+
+    // Modules that were never parsed only have their exports
+    if (m->program != nullptr) {
+      Encoder e;
+      e.kinds = kinds;
+      e.node(m->program);
+    }
+  }
+
+  for (std::size_t k = 0; k < kind_count; k++) {
+    if (kinds[k] != 0)
+      Trace::count(std::string("AST nodes: ") + kind_names[k], kinds[k]);
+  }
+}
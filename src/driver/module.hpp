@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../ast/ast.hpp"
+#include "../memory/memory.hpp"
+#include "driver.hpp"
+
+/*
+ * Multi-file programs
+ *
+ *   @use math;            math.zu next to the file that uses it
+ *   @use "lib/io.zu";     a path relative to that file
+ *
+ * Only `pub const` functions and enums are visible to the modules that use
+ * them. Every module shares one symbol namespace, so a name may only be
+ * defined once across the whole program, and cycles are not allowed.
+ */
+
+namespace Driver {
+// A top level function or enum
+struct Symbol {
+  std::string name;
+  NodeKind kind;
+  bool is_pub;
+};
+
+// One source file of the program and everything parsed out of it
+struct Module {
+  std::string path;
+  Source source;
+  std::unique_ptr<Allocator::ArenaAllocator> arena;
+  std::vector<std::unique_ptr<Allocator::ArenaAllocator>> chunk_arenas;
+  // Null until parsed, which a module with a cached interface only is when
+  // its code has to be generated
+  ProgramStmt *program = nullptr;
+  std::vector<std::size_t> deps; // the modules it @uses, by index
+
+  // What the rest of the build needs to know about it. Comes from its AST
+  // or from its interface file, see driver/interface.hpp.
+  std::string digest;                      // hash of its canonical AST
+  std::vector<std::string> uses;           // @use paths as written
+  std::vector<Symbol> symbols;             // every top level fn and enum
+  std::vector<std::string> calls;          // callees defined elsewhere
+  std::vector<const Node::Stmt *> exports; // its pub functions and enums
+  std::string interface; // canonical encoding of what it exports
+};
+
+using Modules = std::vector<std::unique_ptr<Module>>;
+
+// Loads every module that has no program yet, then follows @use until the
+// whole graph is loaded. modules[0] is the root. Independent modules are
+// loaded in parallel. A module of `previous` whose source did not change is
+// taken over, and one with an interface in the build cache is not parsed.
+// With `previous`, sources are read into memory rather than mapped, as the
+// caller keeps them to compare with the next load.
+// Returns 0 or the exit status of the failed build.
+int load_modules(const Options &opts, Modules &modules, std::ostream &out,
+                 std::ostream &err, Modules *previous = nullptr);
+
+// Parses the listed modules that were loaded from their interface files
+int parse_modules(const Options &opts, Modules &modules,
+                  const std::vector<std::size_t> &which, std::ostream &out);
+
+// What code generation needs to compile each module on its own
+std::vector<Unit> units_of(const Modules &modules);
+
+// Reports source, arena and AST sizes of every module to the --mem-report
+// counters
+void count_memory(const Modules &modules);
+}; // namespace Driver
@@ -0,0 +1,127 @@
+#include "source.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Driver;
+
+// Below this, one read() is cheaper than setting up a mapping
+static constexpr std::size_t map_threshold = 16 * 1024;
+
+Source &Source::operator=(Source &&other) noexcept {
+  if (this == &other)
+    return *this;
+  release();
+  map = other.map;
+  map_size = other.map_size;
+  length = other.length;
+  owned = std::move(other.owned);
+  // A short string moves its bytes, so point at our own copy
+  data = map != nullptr ? other.data : owned.c_str();
+
+  other.map = nullptr;
+  other.map_size = 0;
+  other.release();
+  return *this;
+}
+
+void Source::release() {
+  if (map != nullptr)
+    ::munmap(map, map_size);
+  map = nullptr;
+  map_size = 0;
+  owned.clear();
+  data = "";
+  length = 0;
+}
+
+// Reads until EOF straight into `out`, starting with room for `hint` bytes
+static bool read_all(int fd, std::string &out, std::size_t hint) {
+  std::size_t used = 0;
+  out.resize(hint);
+  while (true) {
+    if (used == out.size())
+      out.resize(out.size() * 2);
+    ssize_t n = ::read(fd, &out[used], out.size() - used);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    used += std::size_t(n);
+  }
+  out.resize(used);
+  return true;
+}
+
+// Maps the file with at least one zero byte behind it. The rest of the last
+// page of a file reads as zero, and when the file ends right on a page
+// boundary an anonymous zero page is left behind it. A file truncated while
+// it is mapped would fault.
+static void *map_file(int fd, std::size_t size, std::size_t &map_size) {
+  std::size_t page = std::size_t(::sysconf(_SC_PAGESIZE));
+  map_size = (size / page + 1) * page;
+
+  void *base = ::mmap(nullptr, map_size, PROT_READ,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return nullptr;
+  if (::mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+      MAP_FAILED) {
+    ::munmap(base, map_size);
+    return nullptr;
+  }
+
+  ::madvise(base, size, MADV_SEQUENTIAL); // the lexer reads front to back
+  return base;
+}
+
+bool Driver::read_file(const std::string &filename, Source &out,
+                       std::ostream &err, bool copy) {
+  out.release();
+
+  if (filename == "-") {
+    if (!read_all(STDIN_FILENO, out.owned, 64 * 1024)) {
+      err << "Failed to read stdin: " << std::strerror(errno) << "\n";
+      return false;
+    }
+    out.data = out.owned.c_str();
+    out.length = out.owned.size();
+    return true;
+  }
+
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    err << "Failed to open file: " << filename << "\n";
+    return false;
+  }
+
+  struct stat st;
+  bool ok = ::fstat(fd, &st) == 0;
+  std::size_t size = ok ? std::size_t(st.st_size) : 0;
+  if (ok && !copy && S_ISREG(st.st_mode) && size >= map_threshold) {
+    out.map = map_file(fd, size, out.map_size);
+    ok = out.map != nullptr;
+    out.data = ok ? static_cast<const char *>(out.map) : "";
+    out.length = ok ? size : 0;
+  } else if (ok) {
+    // One spare byte lets a regular file finish without growing the buffer
+    ok = read_all(fd, out.owned, S_ISREG(st.st_mode) ? size + 1 : 64 * 1024);
+    out.data = out.owned.c_str();
+    out.length = out.owned.size();
+  }
+
+  int saved = errno;
+  ::close(fd);
+  if (!ok) {
+    err << "Failed to read file: " << filename << ": "
+        << std::strerror(saved) << "\n";
+    out.release();
+  }
+  return ok;
+}
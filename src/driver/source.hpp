@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+
+/*
+ * Source text
+ *
+ * Large regular files are mapped read only instead of copied, so even
+ * generated inputs of hundreds of MB start lexing right away, unless the
+ * text outlives the build that reads it, see read_file. Small files,
+ * stdin ("-") and pipes are read once into memory. Either way the text is
+ * followed by a '\0', which is where the lexer stops.
+ */
+
+namespace Driver {
+class Source {
+public:
+  Source() = default;
+  Source(const Source &) = delete;
+  Source &operator=(const Source &) = delete;
+  Source(Source &&other) noexcept { *this = std::move(other); }
+  Source &operator=(Source &&other) noexcept;
+  ~Source() { release(); }
+
+  const char *c_str() const { return data; }
+  std::size_t size() const { return length; }
+  llvm::StringRef text() const { return llvm::StringRef(data, length); }
+
+  friend bool read_file(const std::string &filename, Source &out,
+                        std::ostream &err, bool copy);
+
+private:
+  void release();
+
+  const char *data = "";
+  std::size_t length = 0;
+  void *map = nullptr; // includes the zero page behind the file, if any
+  std::size_t map_size = 0;
+  std::string owned; // when the text was read rather than mapped
+};
+
+// "-" reads stdin. With `copy` the file is always read, never mapped: a
+// mapping shows whatever is written to the file later and faults once it is
+// truncated, so text kept around to compare with the next save has to be a
+// copy of its own.
+bool read_file(const std::string &filename, Source &out, std::ostream &err,
+               bool copy = false);
+}; // namespace Driver
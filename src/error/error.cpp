@@ -35,7 +35,9 @@ std::string Error::generate_line(const std::vector<Lexer::Token> &tks, int line,
   try {
     for (const Lexer::Token &tk : tks) {
       if (tk.line != line) continue;
-      ln += col.color(generate_whitespace(tk.whitespace) + tk.value, Color::WHITE, false, true);
+      ln += col.color(generate_whitespace(tk.whitespace) +
+                          std::string(tk.start, std::size_t(tk.length)),
+                      Color::WHITE, false, true);
     }
     ln += "\n";
     return ln;
@@ -45,12 +47,12 @@ std::string Error::generate_line(const std::vector<Lexer::Token> &tks, int line,
   }
 }
 
-bool Error::report_error() {
+bool Error::report_error(std::ostream &out) {
   if (errors.size() > 0) {
-    std::cout << "Total Errors: "
-              << col.color(std::to_string(errors.size()), Color::RED) << "\n";
+    out << "Total Errors: "
+        << col.color(std::to_string(errors.size()), Color::RED) << "\n";
     for (std::string error : errors)
-      std::cout << error << std::endl;
+      out << error << std::endl;
     return true;
   }
   return false;
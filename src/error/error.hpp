@@ -1,5 +1,6 @@
 #pragma once
 
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -17,12 +18,15 @@
 
 class Error {
  public:
-  inline static std::vector<std::string> errors = {};
+  // Per thread so parser workers never race; they hand theirs back in order
+  inline static thread_local std::vector<std::string> errors = {};
+  // The file being lexed or parsed on this thread, shown in diagnostics
+  inline static thread_local std::string file = "main.xi";
   static void handle_lexer_error(Lexer::lexer &lex, std::string error_type,
                                  std::string file_path, std::string msg);
   static void handle_error(std::string error_type, std::string file_path,
                            std::string msg, const std::vector<Lexer::Token> &tks, int line, int pos);
-  static bool report_error();
+  static bool report_error(std::ostream &out = std::cout);
 
  private:
   static std::string error_head(std::string error_type, int line, int pos,
@@ -40,6 +40,7 @@ Token Lexer::lexer::make_token(Kind k, int whitespace_count) {
   tk.kind = k;
   tk.start = start;
   tk.value = std::string(start, current);
+  tk.length = int(current - start);
   tk.whitespace = whitespace_count;
   tk.line = line;
   tk.pos = pos - 1;
@@ -58,7 +59,17 @@ Token Lexer::lexer::number(int whitespace_count) {
   while (isdigit(peek(0)))
     advance();
 
-  if (peek(0) == '.') {
+  // A fraction needs a digit after the point
+  if (peek(0) == '.' && isdigit(peek(1))) {
+    advance();
+    while (isdigit(peek(0)))
+      advance();
+  }
+
+  if ((peek(0) == 'e' || peek(0) == 'E') &&
+      (isdigit(peek(1)) ||
+       ((peek(1) == '+' || peek(1) == '-') && isdigit(peek(2))))) {
+    advance();
     advance();
     while (isdigit(peek(0)))
       advance();
@@ -74,6 +85,50 @@ Token Lexer::lexer::identifier(int whitespace_count) {
   return make_token(check_map(ident), whitespace_count);
 }
 
+// Escapes are decoded here, once, so the parser and codegen only ever see
+// the bytes a string stands for
+Token Lexer::lexer::string_literal(int whitespace_count) {
+  std::string bytes;
+  while (peek(0) != '"' && peek(0) != '\n' && !is_at_end()) {
+    char c = advance();
+    if (c != '\\') {
+      bytes += c;
+      continue;
+    }
+    if (peek(0) == '\n' || is_at_end())
+      break;
+    switch (char escaped = advance()) {
+    case 'n':
+      bytes += '\n';
+      break;
+    case 't':
+      bytes += '\t';
+      break;
+    case 'r':
+      bytes += '\r';
+      break;
+    case '0':
+      bytes += '\0';
+      break;
+    default: // \\, \" and anything else stand for themselves
+      bytes += escaped;
+      break;
+    }
+  }
+
+  // Never step over the '\0' that ends the source
+  if (peek(0) != '"') {
+    Error::handle_lexer_error(*this, "Lexical", Error::file,
+                              "Unterminated string");
+    return make_token(Kind::unknown, whitespace_count);
+  }
+  advance();
+
+  Token tk = make_token(Kind::string, whitespace_count);
+  tk.value = std::move(bytes);
+  return tk;
+}
+
 int Lexer::lexer::skip_whitespace() {
   int count = 0;
   for (;;) {
@@ -113,9 +168,11 @@ Token Lexer::lexer::scan_token() {
 
   char c = advance();
 
-  if (c == '@')
-    return make_token(builtins[identifier(whitespace_count).value],
+  if (c == '@') {
+    auto it = builtins.find(identifier(whitespace_count).value);
+    return make_token(it != builtins.end() ? it->second : Kind::number,
                       whitespace_count);
+  }
 
   if (isdigit(c))
     return number(whitespace_count);
@@ -123,20 +180,18 @@ Token Lexer::lexer::scan_token() {
   if (isalpha(c))
     return identifier(whitespace_count);
 
-  if (c == '"') {
-    while (peek(0) != '"' && !is_at_end()) {
-      if (peek(0) == '\n') {
-        Error::handle_lexer_error(*this, "Lexical", "math.xi",
-                                  "Unterminated string");
-        return make_token(Kind::unknown, whitespace_count);
-      }
-      advance();
-    }
-    advance();
-    return make_token(Kind::string, whitespace_count);
-  }
+  if (c == '"')
+    return string_literal(whitespace_count);
 
   char next = peek(0);
+  // The only three character token, and the only one starting with a '.'
+  if (c == '.' && next == '.') {
+    advance();
+    if (peek(0) != '=')
+      return make_token(Kind::dot_dot, whitespace_count);
+    advance();
+    return make_token(Kind::dot_dot_equal, whitespace_count);
+  }
   if (auto kind2 = lookup_kind(c, next)) {
     advance();
     return make_token(*kind2, whitespace_count);
@@ -146,6 +201,6 @@ Token Lexer::lexer::scan_token() {
   }
 
   std::string msg = "Token not found '" + std::to_string(c) + "'";
-  Error::handle_lexer_error(*this, "Lexical", "math.xi", msg);
+  Error::handle_lexer_error(*this, "Lexical", Error::file, msg);
   return make_token(Kind::unknown, whitespace_count);
 }
@@ -32,6 +32,8 @@ enum Kind {
   r_brace,   // }
   increment,
   decrement,
+  dot_dot,       // ..
+  dot_dot_equal, // ..=
 
   walrus,
 
@@ -42,6 +44,7 @@ enum Kind {
   _char,
   _bool,
   _str,
+  _strbuf,
   var,
   _const,
   _return,
@@ -55,6 +58,10 @@ enum Kind {
   memcpy,
   _sizeof,
   cast,
+  fastmath,
+  unchecked,
+  loop_hint, // @unroll and the others a loop can start with
+  builtin, // @len and the others that produce a value
   _if,
   _elif,
   _else,
@@ -63,16 +70,20 @@ enum Kind {
   pub,
   priv,
   loop,
+  _in,
 
   eof,
   unknown,
 };
 
+// A string's value is its bytes, without the quotes and with every escape
+// already replaced. The source spelling is always the `length` bytes at
+// `start`.
 struct Token {
   Kind kind;
   std::string value;
   const char *start;
-  int whitespace, line, pos;
+  int length, whitespace, line, pos;
 };
 
 class lexer {
@@ -89,24 +100,33 @@ private:
   const char *start;
   const char *source;
 
-  std::unordered_map<std::string, Kind> builtins = {
+  // Shared by every lexer, built once per process and only ever read
+  inline static const std::unordered_map<std::string, Kind> builtins = {
       {"@module", Kind::_module}, {"@use", Kind::_use},
       {"@output", Kind::print},   {"@outputln", println},
       {"@alloc", Kind::_alloc},   {"@free", Kind::_free},
       {"@memcpy", Kind::memcpy},  {"@sizeof", Kind::_sizeof},
-      {"@cast", Kind::cast},
+      {"@cast", Kind::cast},      {"@fastmath", Kind::fastmath},
+      {"@unchecked", Kind::unchecked},
+      {"@unroll", Kind::loop_hint},     {"@vectorize", Kind::loop_hint},
+      {"@novectorize", Kind::loop_hint}, {"@interleave", Kind::loop_hint},
+      {"@parallel", Kind::loop_hint},   {"@reduce", Kind::loop_hint},
+      {"@len", Kind::builtin},    {"@strbuf", Kind::builtin},
+      {"@append", Kind::builtin}, {"@str", Kind::builtin},
   };
 
-  std::unordered_map<std::string, Kind> keywords = {
+  inline static const std::unordered_map<std::string, Kind> keywords = {
       {"uint", Kind::_uint},     {"int", Kind::_int},
-      {"float", Kind::_float},   {"char", Kind::_char},
+      {"float", Kind::_float},   {"f64", Kind::_float},
+      {"char", Kind::_char},
       {"bool", Kind::_bool},     {"str", Kind::_str},
+      {"strbuf", Kind::_strbuf},
       {"have", Kind::var},       {"const", Kind::_const},
       {"fn", Kind::fn},          {"return", Kind::_return},
       {"if", Kind::_if},         {"else", Kind::_else},
       {"struct", Kind::_struct}, {"enum", Kind::_enum},
       {"pub", Kind::pub},        {"priv", Kind::priv},
-      {"loop", Kind::loop},
+      {"loop", Kind::loop},      {"in", Kind::_in},
   };
 
   static constexpr std::pair<char, Kind> token_map[] = {
@@ -132,6 +152,7 @@ private:
   Token make_token(Kind k, int whitespace_count);
   Token identifier(int whitespace_count);
   Token number(int whitespace_count);
+  Token string_literal(int whitespace_count);
 
   Kind check_map(std::string ident);
   int skip_whitespace();
@@ -4,6 +4,9 @@
 #include <cstddef>
 #include <cstdlib>
 #include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace Allocator {
 struct Buffer {
@@ -16,6 +19,8 @@ struct Buffer {
     // Align the whole block to max(alignment, alignof(Buffer))
     std::size_t buffer_align = std::max(alignment, alignof(Buffer));
     std::size_t total_size = sizeof(Buffer) + s + buffer_align;
+    // aligned_alloc wants the size to be a multiple of the alignment
+    total_size = (total_size + buffer_align - 1) & ~(buffer_align - 1);
 
     void *raw = std::aligned_alloc(buffer_align, total_size);
     if (!raw)
@@ -74,10 +79,31 @@ public:
   template <typename T, typename... Args> T *emplace(Args &&...args) {
     auto p = static_cast<T *>(alloc(sizeof(T), alignof(T)));
     new (p) T(std::forward<Args>(args)...);
+    // Nodes own std::strings, which would leak if nothing destroyed them
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      dtors.push_back({p, [](void *obj) { static_cast<T *>(obj)->~T(); }});
     return p;
   }
 
+  // Blocks allocated so far and the bytes they hold, whether used or not
+  std::size_t blocks() const {
+    std::size_t n = 0;
+    for (Buffer *b = head; b != nullptr; b = b->next)
+      n++;
+    return n;
+  }
+
+  std::size_t capacity() const {
+    std::size_t bytes = 0;
+    for (Buffer *b = head; b != nullptr; b = b->next)
+      bytes += b->size;
+    return bytes;
+  }
+
   void reset() {
+    for (auto it = dtors.rbegin(); it != dtors.rend(); it++)
+      it->second(it->first);
+    dtors.clear();
     offset = 0;
     buffer = head;
   }
@@ -95,5 +121,6 @@ private:
   std::size_t offset = 0;
   Buffer *buffer = nullptr;
   Buffer *head = nullptr;
+  std::vector<std::pair<void *, void (*)(void *)>> dtors;
 };
 } // namespace Allocator
@@ -68,10 +68,63 @@ Node::Expr *Parser::_call(PStruct *psr, Node::Expr *left, BindingPower bp) {
   return psr->arena.emplace<Call>(left, args);
 }
 
+Node::Expr *Parser::builtin(PStruct *psr) {
+  std::string name = psr->advance().value.substr(1); // drop the @
+  psr->expect(Lexer::Kind::l_paren, "Expected '(' after @" + name);
+  std::vector<Node::Expr *> args;
+  while (psr->current().kind != Lexer::Kind::r_paren &&
+         psr->current().kind != Lexer::Kind::eof) {
+    args.push_back(parse_expr(psr, BindingPower::default_value));
+    if (psr->current().kind == Lexer::Kind::comma)
+      psr->advance();
+  }
+  psr->expect(Lexer::Kind::r_paren, "Expected ')' to close @" + name);
+  return psr->arena.emplace<Builtin>(name, args);
+}
+
+Node::Expr *Parser::array(PStruct *psr) {
+  psr->advance(); // consume the [
+  std::vector<Node::Expr *> elems;
+  while (psr->current().kind != Lexer::Kind::r_bracket &&
+         psr->current().kind != Lexer::Kind::eof) {
+    elems.push_back(parse_expr(psr, BindingPower::default_value));
+    if (psr->current().kind == Lexer::Kind::comma)
+      psr->advance();
+  }
+  psr->expect(Lexer::Kind::r_bracket, "Expected ']' to close the array");
+  return psr->arena.emplace<ArrayLit>(elems);
+}
+
+// left[index] or left[start:end]
+Node::Expr *Parser::_index(PStruct *psr, Node::Expr *left, BindingPower bp) {
+  (void)bp;
+  psr->advance(); // consume the [
+  Node::Expr *start = nullptr, *end = nullptr;
+  if (psr->current().kind != Lexer::Kind::colon) {
+    start = parse_expr(psr, BindingPower::default_value);
+    if (psr->current().kind == Lexer::Kind::r_bracket) {
+      psr->advance();
+      return psr->arena.emplace<Index>(left, start);
+    }
+  }
+  psr->expect(Lexer::Kind::colon, "Expected ':' between the bounds of a slice");
+  if (psr->current().kind != Lexer::Kind::r_bracket)
+    end = parse_expr(psr, BindingPower::default_value);
+  psr->expect(Lexer::Kind::r_bracket, "Expected ']' to close the slice");
+  return psr->arena.emplace<Slice>(left, start, end);
+}
+
+// start..end or start..=end
+Node::Expr *Parser::_range(PStruct *psr, Node::Expr *left, BindingPower bp) {
+  bool inclusive = psr->advance().kind == Lexer::Kind::dot_dot_equal;
+  Node::Expr *end = parse_expr(psr, bp);
+  return psr->arena.emplace<Range>(left, end, inclusive);
+}
+
 Node::Expr *Parser::assign(PStruct *psr, Node::Expr *left, BindingPower bp) {
   (void)bp;
 
-  Lexer::Token op = psr->current();
+  Lexer::Token op = psr->advance();
   Node::Expr *right = parse_expr(psr, BindingPower::default_value);
 
   return psr->arena.emplace<Assign>(op, left, right);
@@ -0,0 +1,104 @@
+#include "parser.hpp"
+
+#include "../ast/ast.hpp"
+#include "../ast/stmt.hpp"
+#include "../memory/memory.hpp"
+#include "../thread/pool.hpp"
+#include "../trace/trace.hpp"
+
+std::vector<std::size_t>
+Parser::split_top_level(const std::vector<Lexer::Token> &tks,
+                        std::size_t min_tokens) {
+  std::vector<std::size_t> starts = {0};
+  int depth = 0;
+
+  for (std::size_t i = 0; i + 2 < tks.size(); i++) {
+    switch (tks[i].kind) {
+    case Lexer::Kind::l_brace:
+    case Lexer::Kind::l_paren:
+      depth++;
+      continue;
+    case Lexer::Kind::r_brace:
+    case Lexer::Kind::r_paren:
+      depth--;
+      continue;
+    case Lexer::Kind::_const:
+      break;
+    default:
+      continue;
+    }
+
+    if (depth != 0 || tks[i + 1].kind != Lexer::Kind::ident ||
+        tks[i + 2].kind != Lexer::Kind::walrus)
+      continue;
+    // A pub belongs to the const it marks
+    std::size_t start =
+        i > 0 && tks[i - 1].kind == Lexer::Kind::pub ? i - 1 : i;
+    if (start - starts.back() >= min_tokens)
+      starts.push_back(start);
+  }
+
+  return starts;
+}
+
+std::vector<Node::Stmt *>
+Parser::parse_stmts(std::vector<Lexer::Token> tks,
+                    Allocator::ArenaAllocator &arena) {
+  PStruct p = PStruct{std::move(tks), {}, arena, 0};
+  while (p.had_tokens()) {
+    if (p.current().kind == Lexer::Kind::eof)
+      break;
+    p.pr.push_back(parse_stmt(&p));
+  }
+  return std::move(p.pr);
+}
+
+Node::Stmt *Parser::parse_parallel(
+    std::vector<Lexer::Token> tks, Allocator::ArenaAllocator &arena,
+    std::vector<std::unique_ptr<Allocator::ArenaAllocator>> &arenas,
+    std::size_t jobs) {
+  std::vector<std::size_t> starts = split_top_level(tks, min_chunk_tokens);
+  if (starts.size() == 1) {
+    Trace::Scope scope("parse", Error::file);
+    return parse(std::move(tks), arena);
+  }
+
+  std::size_t count = starts.size();
+  starts.push_back(tks.size() - 1); // everything but the eof
+
+  std::vector<std::vector<Node::Stmt *>> stmts(count);
+  std::vector<std::vector<std::string>> errors(count);
+  std::size_t first = arenas.size();
+  for (std::size_t i = 0; i < count; i++)
+    arenas.push_back(std::make_unique<Allocator::ArenaAllocator>(1024));
+
+  const std::string file = Error::file;
+  Thread::parallel_for(count, jobs, [&](std::size_t i) {
+    Trace::Scope scope("parse", file);
+    // Each chunk is a standalone token stream that ends in its own eof
+    std::vector<Lexer::Token> chunk(
+        std::make_move_iterator(tks.begin() + long(starts[i])),
+        std::make_move_iterator(tks.begin() + long(starts[i + 1])));
+    chunk.push_back(tks.back());
+
+    std::vector<std::string> saved = std::move(Error::errors);
+    std::string saved_file = Error::file;
+    Error::errors.clear();
+    Error::file = file;
+
+    stmts[i] = parse_stmts(std::move(chunk), *arenas[first + i]);
+    errors[i] = std::move(Error::errors);
+    Error::errors = std::move(saved);
+    Error::file = saved_file;
+  });
+
+  // Stitch everything back together in source order
+  std::vector<Node::Stmt *> program;
+  for (std::size_t i = 0; i < count; i++) {
+    program.insert(program.end(), stmts[i].begin(), stmts[i].end());
+    Error::errors.insert(Error::errors.end(), errors[i].begin(),
+                         errors[i].end());
+  }
+
+  return arena.emplace<ProgramStmt>(program, arena);
+}
@@ -29,6 +29,8 @@ Parser::BindingPower Parser::get_bp(Lexer::Kind kind) {
     return BindingPower::multiplicative;
   case Lexer::Kind::l_paren:
     return BindingPower::call;
+  case Lexer::Kind::l_bracket:
+    return BindingPower::member;
   case Lexer::Kind::equal_equal:
   case Lexer::Kind::not_equal:
   case Lexer::Kind::greater_equal:
@@ -41,6 +43,9 @@ Parser::BindingPower Parser::get_bp(Lexer::Kind kind) {
     return BindingPower::prefix; // right associative
   case Lexer::Kind::equals:
     return BindingPower::assignment;
+  case Lexer::Kind::dot_dot:
+  case Lexer::Kind::dot_dot_equal:
+    return BindingPower::range;
   default:
     return BindingPower::default_value;
   }
@@ -56,6 +61,10 @@ Node::Expr *Parser::nud(PStruct *psr) {
     return unary(psr);
   case Lexer::Kind::l_paren:
     return grouping(psr);
+  case Lexer::Kind::builtin:
+    return builtin(psr);
+  case Lexer::Kind::l_bracket:
+    return array(psr);
   default:
     psr->advance();
     return nullptr;
@@ -78,6 +87,11 @@ Node::Expr *Parser::led(PStruct *psr, Node::Expr *left, BindingPower bp) {
     return binary(psr, left, bp);
   case Lexer::Kind::l_paren:
     return _call(psr, left, bp);
+  case Lexer::Kind::l_bracket:
+    return _index(psr, left, bp);
+  case Lexer::Kind::dot_dot:
+  case Lexer::Kind::dot_dot_equal:
+    return _range(psr, left, bp);
   case Lexer::Kind::equals:
     return assign(psr, left, bp);
   case Lexer::Kind::increment:
@@ -98,7 +112,21 @@ Node::Type *Parser::parse_type(PStruct *psr) {
   case Lexer::Kind::_bool:
   case Lexer::Kind::_char:
   case Lexer::Kind::_str:
+  case Lexer::Kind::_strbuf:
     return psr->arena.emplace<SymbolType>(psr->advance().value);
+  case Lexer::Kind::l_bracket: {
+    // [N]T is an array of N Ts and []T a slice of them. They are named by
+    // how they are spelled, which is all codegen and interfaces need.
+    psr->advance();
+    std::string name = "[";
+    if (psr->current().kind == Lexer::Kind::number)
+      name += psr->advance().value;
+    psr->expect(Lexer::Kind::r_bracket, "Expected a ']' in an array type");
+    auto *elem = static_cast<SymbolType *>(parse_type(psr));
+    if (elem == nullptr)
+      return nullptr;
+    return psr->arena.emplace<SymbolType>(name + "]" + elem->name);
+  }
   default:
     psr->advance();
     return nullptr;
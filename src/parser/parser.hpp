@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 #include "../ast/ast.hpp"
@@ -20,7 +22,7 @@ enum BindingPower {
   comparison = 7,
   additive = 8,
   multiplicative = 9,
-  range = 9,
+  range = 6, // looser than arithmetic, so 0..n + 1 ends at n + 1
   power = 10,
   prefix = 11,
   postfix = 12,
@@ -53,7 +55,7 @@ struct Parser::PStruct {
   Lexer::Token expect(Lexer::Kind tk, std::string msg) {
     if (peek(0).kind == tk)
       return advance();
-    Error::handle_error("Parser", "main.xi", msg, tks, current().line,
+    Error::handle_error("Parser", Error::file, msg, tks, current().line,
                         current().pos);
     return current();
   }
@@ -62,6 +64,22 @@ struct Parser::PStruct {
 namespace Parser {
 Node::Stmt *parse(std::vector<Lexer::Token> tks,
                   Allocator::ArenaAllocator &arena);
+
+// Parallel front end (parallel.cpp). The token stream is cut into chunks at
+// top level `const ident :=` boundaries, in front of the `pub` of a `pub
+// const`. Every chunk gets its own arena in `arenas`, which must outlive the
+// returned program. Chunking only depends on the tokens, so the AST and
+// diagnostics are the same for any `jobs`.
+inline constexpr std::size_t min_chunk_tokens = 8192;
+std::vector<std::size_t> split_top_level(const std::vector<Lexer::Token> &tks,
+                                         std::size_t min_tokens);
+Node::Stmt *
+parse_parallel(std::vector<Lexer::Token> tks, Allocator::ArenaAllocator &arena,
+               std::vector<std::unique_ptr<Allocator::ArenaAllocator>> &arenas,
+               std::size_t jobs);
+// Parses top level stmts until the eof that `tks` must end with
+std::vector<Node::Stmt *> parse_stmts(std::vector<Lexer::Token> tks,
+                                      Allocator::ArenaAllocator &arena);
 Node::Expr *parse_expr(PStruct *psr, BindingPower bp);
 Node::Stmt *parse_stmt(PStruct *psr);
 Node::Type *parse_type(PStruct *psr);
@@ -74,12 +92,16 @@ BindingPower get_bp(Lexer::Kind kind);
 Node::Expr *primary(PStruct *psr);
 Node::Expr *unary(PStruct *psr);
 Node::Expr *grouping(PStruct *psr);
+Node::Expr *builtin(PStruct *psr);
+Node::Expr *array(PStruct *psr);
 
 // led functions
 Node::Expr *binary(PStruct *psr, Node::Expr *left, BindingPower bp);
 Node::Expr *_call(PStruct *psr, Node::Expr *left, BindingPower bp);
 Node::Expr *assign(PStruct *psr, Node::Expr *left, BindingPower bp);
 Node::Expr *_prefix(PStruct *psr, Node::Expr *left, BindingPower bp);
+Node::Expr *_index(PStruct *psr, Node::Expr *left, BindingPower bp);
+Node::Expr *_range(PStruct *psr, Node::Expr *left, BindingPower bp);
 
 // type functions
 Node::Type *tnud(PStruct *psr);
@@ -88,6 +110,8 @@ BindingPower tget_bp(PStruct *psr, Lexer::Kind tk);
 
 // stmt functions
 Node::Stmt *module_stmt(PStruct *psr);
+Node::Stmt *use_stmt(PStruct *psr);
+Node::Stmt *pub_stmt(PStruct *psr);
 Node::Stmt *expr_stmt(PStruct *psr);
 Node::Stmt *var_stmt(PStruct *psr);
 Node::Stmt *const_stmt(PStruct *psr);
@@ -8,6 +8,10 @@ Node::Stmt *Parser::parse_stmt(PStruct *psr) {
   switch (psr->current().kind) {
   case Lexer::Kind::_module:
     return module_stmt(psr);
+  case Lexer::Kind::_use:
+    return use_stmt(psr);
+  case Lexer::Kind::pub:
+    return pub_stmt(psr);
   case Lexer::Kind::var:
     return var_stmt(psr);
   case Lexer::Kind::print:
@@ -39,8 +43,36 @@ Node::Stmt *Parser::module_stmt(PStruct *psr) {
   return psr->arena.emplace<ModuleStmt>(name);
 }
 
+Node::Stmt *Parser::use_stmt(PStruct *psr) {
+  psr->expect(Lexer::Kind::_use, "Expected the @use keyword to use a module");
+  std::string path;
+  if (psr->current().kind == Lexer::Kind::string)
+    path = psr->advance().value;
+  else
+    path = psr->expect(Lexer::Kind::ident,
+                       "Expected a module name or a path after @use")
+               .value;
+  psr->expect(Lexer::Kind::semicolon,
+              "Expected ';' at the end of the use stmt");
+
+  return psr->arena.emplace<UseStmt>(path);
+}
+
+Node::Stmt *Parser::pub_stmt(PStruct *psr) {
+  psr->expect(Lexer::Kind::pub, "Expected the keyword 'pub'");
+  Node::Stmt *stmt = const_stmt(psr);
+
+  if (stmt != nullptr && stmt->kind == NodeKind::fn_stmt)
+    static_cast<FnStmt *>(stmt)->is_pub = true;
+  else if (stmt != nullptr && stmt->kind == NodeKind::enum_stmt)
+    static_cast<EnumStmt *>(stmt)->is_pub = true;
+  return stmt;
+}
+
 Node::Stmt *Parser::expr_stmt(PStruct *psr) {
   Node::Expr *expr = parse_expr(psr, BindingPower::default_value);
+  if (psr->current().kind == Lexer::Kind::semicolon)
+    psr->advance();
   return psr->arena.emplace<ExprStmt>(expr);
 }
 
@@ -54,15 +86,37 @@ Node::Stmt *Parser::const_stmt(PStruct *psr) {
   psr->expect(Lexer::Kind::walrus,
               "Expected a ':=' after the name to declare the body");
 
+  // const f := @fastmath @unchecked fn (...) float { ... };
+  bool fastmath = false, unchecked = false, attributes = false;
+  while (psr->current().kind == Lexer::Kind::fastmath ||
+         psr->current().kind == Lexer::Kind::unchecked) {
+    bool &flag = psr->current().kind == Lexer::Kind::fastmath ? fastmath
+                                                              : unchecked;
+    flag = attributes = true;
+    psr->advance();
+  }
+  if (attributes && psr->current().kind != Lexer::Kind::fn) {
+    Error::handle_error("Parser", Error::file,
+                        "Expected a function after its attributes", psr->tks,
+                        psr->current().line, psr->current().pos);
+    return nullptr;
+  }
+
   switch (psr->current().kind) {
-  case Lexer::Kind::fn:
-    return fn_stmt(psr, name);
+  case Lexer::Kind::fn: {
+    Node::Stmt *fn = fn_stmt(psr, name);
+    if (fn != nullptr) {
+      static_cast<FnStmt *>(fn)->fastmath = fastmath;
+      static_cast<FnStmt *>(fn)->unchecked = unchecked;
+    }
+    return fn;
+  }
   case Lexer::Kind::_enum:
     return enum_stmt(psr, name);
   default:
     std::string msg = "Expected a 'const' stmt to lead to either an enum, "
                       "struct, or function";
-    Error::handle_error("Parser", "main.xi", msg, psr->tks, psr->current().line,
+    Error::handle_error("Parser", Error::file, msg, psr->tks, psr->current().line,
                         psr->current().pos);
     break;
   }
@@ -126,7 +180,7 @@ Node::Stmt *Parser::fn_stmt(PStruct *psr, std::string name) {
   // parse the return type
   Node::Type *type = parse_type(psr);
   if (type == nullptr)
-    Error::handle_error("Parser", "main.xi",
+    Error::handle_error("Parser", Error::file,
                         "Expected a return type for the function", psr->tks,
                         psr->current().line, psr->current().pos);
 
@@ -202,18 +256,95 @@ Node::Stmt *Parser::return_stmt(PStruct *psr) {
  * loop (i = 0; i < 10) {}
  * loop (i < 10) : (i++) {}
  * loop (i < 10) {}
+ * loop (i in 0..10) {}
+ * loop (i in 0..=9) {}
+ * loop @unroll(4) @vectorize(8) @interleave(2) @novectorize (...) {}
+ * loop @parallel @reduce(+: sum) @reduce(min: low) (i in 0..n) {}
  */
 
 Node::Stmt *Parser::loop_stmt(PStruct *psr) {
   psr->expect(Lexer::Kind::loop, "Expected a 'loop' keyword to start a loop");
-  
+
+  std::uint64_t unroll = 0, vectorize = 0, interleave = 0;
+  bool novectorize = false, parallel = false;
+  std::vector<LoopStmt::Reduction> reductions;
+  Lexer::Token first_hint = psr->current();
+  while (psr->current().kind == Lexer::Kind::loop_hint) {
+    std::string hint = psr->advance().value;
+    if (hint == "@novectorize") {
+      novectorize = true;
+      continue;
+    }
+    if (hint == "@parallel") {
+      parallel = true;
+      continue;
+    }
+    if (hint == "@reduce") {
+      psr->expect(Lexer::Kind::l_paren, "Expected '(' after @reduce");
+      Lexer::Token op = psr->advance();
+      if (op.kind != Lexer::Kind::plus && op.kind != Lexer::Kind::star &&
+          op.value != "min" && op.value != "max")
+        Error::handle_error("Parser", Error::file,
+                            "@reduce(op: var) combines with +, *, min or max",
+                            psr->tks, op.line, op.pos);
+      psr->expect(Lexer::Kind::colon, "Expected ':' after the @reduce op");
+      Lexer::Token name = psr->expect(Lexer::Kind::ident,
+                                      "Expected the variable to reduce into");
+      psr->expect(Lexer::Kind::r_paren, "Expected ')' to close @reduce");
+      for (const LoopStmt::Reduction &r : reductions)
+        if (r.var == name.value)
+          Error::handle_error("Parser", Error::file,
+                              name.value + " already has a @reduce", psr->tks,
+                              name.line, name.pos);
+      reductions.push_back({op.value, name.value});
+      continue;
+    }
+    psr->expect(Lexer::Kind::l_paren, "Expected '(' after " + hint);
+    Lexer::Token count =
+        psr->expect(Lexer::Kind::number, "Expected a count in " + hint + "(n)");
+    psr->expect(Lexer::Kind::r_paren, "Expected ')' to close " + hint);
+
+    std::uint64_t n = 0;
+    if (count.kind == Lexer::Kind::number &&
+        count.value.find_first_not_of("0123456789") == std::string::npos)
+      n = std::stoull(count.value);
+    if (n == 0 || n > 1024)
+      Error::handle_error("Parser", Error::file,
+                          hint + "(n) takes a whole number from 1 to 1024",
+                          psr->tks, count.line, count.pos);
+    else if (hint == "@vectorize" && (n & (n - 1)) != 0)
+      Error::handle_error("Parser", Error::file,
+                          "The width in @vectorize(n) must be a power of two",
+                          psr->tks, count.line, count.pos);
+
+    if (hint == "@unroll")
+      unroll = n;
+    else if (hint == "@vectorize")
+      vectorize = n;
+    else
+      interleave = n;
+  }
+  if (vectorize != 0 && novectorize)
+    Error::handle_error("Parser", Error::file,
+                        "A loop cannot be both @vectorize and @novectorize",
+                        psr->tks, psr->current().line, psr->current().pos);
+
   bool is_for = false;
+  std::string var;
   Node::Expr *init = nullptr;
   Node::Expr *condition = nullptr;
   Node::Expr *optional = nullptr;
 
   psr->expect(Lexer::Kind::l_paren, "Expected a '(' to start a loop");
-  if (psr->current().kind == Lexer::Kind::ident && psr->peek(1).kind == Lexer::Kind::equals) {
+  if (psr->current().kind == Lexer::Kind::ident && psr->peek(1).kind == Lexer::Kind::_in) {
+    var = psr->advance().value;
+    psr->advance(); // consume the in
+    condition = parse_expr(psr, BindingPower::default_value);
+    if (condition == nullptr || condition->kind != NodeKind::range)
+      Error::handle_error("Parser", Error::file,
+                          "Expected a range such as 0..n after 'in'", psr->tks,
+                          psr->current().line, psr->current().pos);
+  } else if (psr->current().kind == Lexer::Kind::ident && psr->peek(1).kind == Lexer::Kind::equals) {
     is_for = true;
     init = parse_expr(psr, BindingPower::default_value);
     psr->expect(Lexer::Kind::semicolon, "Expected a ';' after the init expr");
@@ -223,7 +354,20 @@ Node::Stmt *Parser::loop_stmt(PStruct *psr) {
   }
   psr->expect(Lexer::Kind::r_paren, "Expected a ')' to end the loop condition");
 
+  if (parallel && var.empty())
+    Error::handle_error("Parser", Error::file,
+                        "Only a range loop (i in a..b) can be @parallel",
+                        psr->tks, first_hint.line, first_hint.pos);
+  else if (!parallel && !reductions.empty())
+    Error::handle_error("Parser", Error::file,
+                        "@reduce only applies to a @parallel loop", psr->tks,
+                        first_hint.line, first_hint.pos);
+
   if (psr->current().kind == Lexer::Kind::colon) {
+    if (!var.empty())
+      Error::handle_error("Parser", Error::file,
+                          "A range loop steps by itself, it takes no ': (...)'",
+                          psr->tks, psr->current().line, psr->current().pos);
     psr->expect(Lexer::Kind::colon, "Expected a ':' to start the optional expr");
     psr->expect(Lexer::Kind::l_paren, "Expected a '(' to start the optional expr");
     optional = parse_expr(psr, BindingPower::default_value);
@@ -232,7 +376,15 @@ Node::Stmt *Parser::loop_stmt(PStruct *psr) {
 
   Node::Stmt *block = parse_stmt(psr);
 
-  return psr->arena.emplace<LoopStmt>(is_for, init, condition, optional, block);
+  auto *loop = psr->arena.emplace<LoopStmt>(is_for, init, condition, optional, block);
+  loop->var = var;
+  loop->unroll = unroll;
+  loop->vectorize = vectorize;
+  loop->interleave = interleave;
+  loop->novectorize = novectorize;
+  loop->parallel = parallel;
+  loop->reductions = reductions;
+  return loop;
 }
 
 Node::Stmt *Parser::if_stmt(PStruct *psr) {
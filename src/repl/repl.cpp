@@ -0,0 +1,288 @@
+#include "repl.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../../libs/runtime.h"
+#include "../ast/stmt.hpp"
+#include "../ast/type.hpp"
+#include "../codegen/llvm.hpp"
+#include "../error/error.hpp"
+#include "../lexer/lexer.hpp"
+#include "../memory/memory.hpp"
+#include "../parser/parser.hpp"
+
+namespace {
+struct Global {
+  std::string symbol;
+  llvm::Type *type;
+};
+
+// Everything that has been committed to the JIT so far
+struct Session {
+  std::unique_ptr<llvm::orc::LLJIT> jit;
+  llvm::orc::ThreadSafeContext tsc;
+  std::map<std::string, llvm::FunctionType *> functions;
+  std::map<std::string, Global> globals;
+  std::size_t lines = 0;
+};
+
+// Returns how many brackets are still open, ignoring strings and comments
+int open_brackets(const std::string &src) {
+  int depth = 0;
+  bool in_str = false;
+  for (std::size_t i = 0; i < src.size(); i++) {
+    char c = src[i];
+    if (in_str) {
+      if (c == '\\')
+        i++;
+      else if (c == '"')
+        in_str = false;
+      continue;
+    }
+    if (c == '#') {
+      while (i < src.size() && src[i] != '\n')
+        i++;
+    } else if (c == '"') {
+      in_str = true;
+    } else if (c == '{' || c == '(' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ')' || c == ']') {
+      depth--;
+    }
+  }
+  return depth;
+}
+
+void eval(Session &s, const std::string &input) {
+  Allocator::ArenaAllocator arena(1024);
+  Error::errors.clear();
+
+  Lexer::lexer lx;
+  lx.init_lexer(&lx, input.c_str());
+
+  std::vector<Lexer::Token> tks;
+  while (true) {
+    Lexer::Token tk = lx.scan_token();
+    tks.push_back(tk);
+    if (tk.kind == Lexer::Kind::eof)
+      break;
+  }
+  if (Error::report_error())
+    return;
+
+  auto *program = static_cast<ProgramStmt *>(Parser::parse(tks, arena));
+  if (Error::report_error())
+    return;
+
+  llvm::LLVMContext &ctx = *s.tsc.getContext();
+  std::string id = std::to_string(s.lines++);
+  auto module = std::make_unique<llvm::Module>("repl." + id, ctx);
+  module->setDataLayout(s.jit->getDataLayout());
+  llvm::IRBuilder<> builder(ctx);
+
+  // Make everything from earlier lines visible to this one
+  std::map<std::string, llvm::Value *> named_values;
+  for (auto &[name, type] : s.functions)
+    llvm::Function::Create(type, llvm::Function::ExternalLinkage, name,
+                           *module);
+  for (auto &[name, global] : s.globals)
+    named_values[name] = new llvm::GlobalVariable(
+        *module, global.type, false, llvm::GlobalValue::ExternalLinkage,
+        nullptr, global.symbol);
+
+  llvm::Type *i64 = llvm::Type::getInt64Ty(ctx);
+  std::string entry_name = "__repl_line." + id;
+  llvm::Function *entry = llvm::Function::Create(
+      llvm::FunctionType::get(i64, {}, false),
+      llvm::Function::ExternalLinkage, entry_name, *module);
+  llvm::BasicBlock *cursor = llvm::BasicBlock::Create(ctx, "entry", entry);
+
+  std::map<std::string, llvm::FunctionType *> new_functions;
+  std::map<std::string, Global> new_globals;
+  llvm::Value *result = nullptr;
+
+  for (std::size_t i = 0; i < program->size; i++) {
+    Node::Stmt *stmt = program->stmts[i];
+    builder.SetInsertPoint(cursor);
+    result = nullptr;
+
+    switch (stmt->kind) {
+    case NodeKind::fn_stmt: {
+      // Function bodies get their own scope so their locals do not leak
+      std::map<std::string, llvm::Value *> locals = named_values;
+      auto *fn = llvm::cast_or_null<llvm::Function>(
+          stmt->codegen(ctx, builder, *module, locals));
+      if (!fn)
+        return;
+      if (s.functions.count(fn->getName().str())) {
+        std::cerr << "Redefinition of function: " << fn->getName().str()
+                  << std::endl;
+        return;
+      }
+      new_functions[fn->getName().str()] = fn->getFunctionType();
+      break;
+    }
+    case NodeKind::enum_stmt: {
+      const std::string &name = static_cast<EnumStmt *>(stmt)->name;
+      auto *global = llvm::cast_or_null<llvm::GlobalVariable>(
+          stmt->codegen(ctx, builder, *module, named_values));
+      if (!global)
+        return;
+      new_globals[name] = {global->getName().str(), global->getValueType()};
+      break;
+    }
+    case NodeKind::var_stmt: {
+      // Top level bindings live in globals so later lines can reach them
+      auto *var = static_cast<VarStmt *>(stmt);
+      llvm::Value *init = var->expr->codegen(ctx, builder, named_values);
+      if (!init)
+        return;
+      llvm::Type *type = var->type->codegen(ctx);
+      auto *global = new llvm::GlobalVariable(
+          *module, type, false, llvm::GlobalValue::ExternalLinkage,
+          llvm::Constant::getNullValue(type), var->name + "." + id);
+      if (!Codegen::store(builder, global, type, init))
+        return;
+      named_values[var->name] = global;
+      new_globals[var->name] = {global->getName().str(), type};
+      break;
+    }
+    case NodeKind::expr_stmt: {
+      auto *expr = static_cast<ExprStmt *>(stmt)->expr;
+      if (!expr)
+        break;
+      result = expr->codegen(ctx, builder, named_values);
+      if (!result)
+        return;
+      break;
+    }
+    default:
+      if (!stmt->codegen(ctx, builder, *module, named_values))
+        return;
+      break;
+    }
+
+    if (stmt->kind != NodeKind::fn_stmt)
+      cursor = builder.GetInsertBlock();
+  }
+
+  // Only a trailing integer expression produces a value worth echoing
+  bool has_value = result && result->getType()->isIntegerTy();
+  builder.SetInsertPoint(cursor);
+  if (!cursor->getTerminator())
+    builder.CreateRet(has_value ? builder.CreateIntCast(result, i64, true)
+                                : llvm::ConstantInt::get(i64, 0));
+
+  std::string err;
+  llvm::raw_string_ostream err_stream(err);
+  if (llvm::verifyModule(*module, &err_stream)) {
+    std::cerr << "Invalid code generated:\n" << err_stream.str();
+    return;
+  }
+
+  auto tracker = s.jit->getMainJITDylib().createResourceTracker();
+  if (auto e = s.jit->addIRModule(
+          tracker, llvm::orc::ThreadSafeModule(std::move(module), s.tsc))) {
+    std::cerr << llvm::toString(std::move(e)) << std::endl;
+    return;
+  }
+
+  auto sym = s.jit->lookup(entry_name);
+  if (!sym) {
+    std::cerr << llvm::toString(sym.takeError()) << std::endl;
+    llvm::consumeError(tracker->remove());
+    return;
+  }
+
+  std::cout.flush();
+  auto *fn = reinterpret_cast<int64_t (*)()>(sym->getAddress());
+  int64_t value = fn();
+  if (has_value)
+    std::cout << value << std::endl;
+
+  s.functions.insert(new_functions.begin(), new_functions.end());
+  for (auto &[name, global] : new_globals)
+    s.globals[name] = global;
+
+  // Lines that only evaluated something can be thrown away entirely
+  if (new_functions.empty() && new_globals.empty())
+    llvm::consumeError(tracker->remove());
+}
+} // namespace
+
+int Repl::run() {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  auto jit = llvm::orc::LLJITBuilder().create();
+  if (!jit) {
+    std::cerr << "Failed to start the JIT: "
+              << llvm::toString(jit.takeError()) << std::endl;
+    return -1;
+  }
+
+  Session s;
+  s.jit = std::move(*jit);
+  s.tsc = llvm::orc::ThreadSafeContext(std::make_unique<llvm::LLVMContext>());
+
+  // Resolve write and malloc from the process and the runtime helpers from
+  // the compiler itself
+  auto &dylib = s.jit->getMainJITDylib();
+  dylib.addGenerator(llvm::cantFail(
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          s.jit->getDataLayout().getGlobalPrefix())));
+  const std::pair<const char *, void *> helpers[] = {
+      {"itoa", reinterpret_cast<void *>(&itoa)},
+      {"dtoa", reinterpret_cast<void *>(&dtoa)},
+      {"zura_str_concat", reinterpret_cast<void *>(&zura_str_concat)},
+      {"zura_str_equal", reinterpret_cast<void *>(&zura_str_equal)},
+      {"zura_str_compare", reinterpret_cast<void *>(&zura_str_compare)},
+      {"zura_strbuf_new", reinterpret_cast<void *>(&zura_strbuf_new)},
+      {"zura_strbuf_append", reinterpret_cast<void *>(&zura_strbuf_append)},
+      {"zura_strbuf_append_int",
+       reinterpret_cast<void *>(&zura_strbuf_append_int)},
+      {"zura_strbuf_append_float",
+       reinterpret_cast<void *>(&zura_strbuf_append_float)},
+      {"zura_strbuf_data", reinterpret_cast<void *>(&zura_strbuf_data)},
+      {"zura_strbuf_len", reinterpret_cast<void *>(&zura_strbuf_len)},
+      {"zura_bounds_fail", reinterpret_cast<void *>(&zura_bounds_fail)},
+      {"zura_parallel_for", reinterpret_cast<void *>(&zura_parallel_for)},
+  };
+  llvm::orc::SymbolMap runtime;
+  for (auto [name, address] : helpers)
+    runtime[s.jit->mangleAndIntern(name)] =
+        llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(address),
+                                 llvm::JITSymbolFlags::Exported);
+  llvm::cantFail(dylib.define(llvm::orc::absoluteSymbols(runtime)));
+
+  std::string input, line;
+  while (true) {
+    std::cout << (input.empty() ? ">> " : ".. ") << std::flush;
+    if (!std::getline(std::cin, line))
+      break;
+    if (input.empty() && (line == "exit" || line == "quit"))
+      break;
+
+    input += line + "\n";
+    if (open_brackets(input) > 0)
+      continue;
+
+    if (input.find_first_not_of(" \t\r\n") != std::string::npos)
+      eval(s, input);
+    input.clear();
+  }
+
+  std::cout << std::endl;
+  return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ * zura2 repl
+ *
+ * Keeps one LLVMContext and one ORC LLJIT session alive for the whole
+ * session. Every input is parsed, wrapped into an anonymous function,
+ * JIT-compiled and run. `have` bindings become globals and `const`
+ * declarations stay defined in the JIT, so both survive across lines.
+ */
+
+namespace Repl {
+int run();
+}; // namespace Repl
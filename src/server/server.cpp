@@ -0,0 +1,276 @@
+#include "server.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <llvm/Support/FileSystem.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../cache/cache.hpp"
+#include "../codegen/llvm.hpp"
+#include "../driver/driver.hpp"
+#include "../thread/pool.hpp"
+
+static bool write_all(int fd, const char *data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= std::size_t(n);
+  }
+  return true;
+}
+
+static bool read_all(int fd, char *data, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::read(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    size -= std::size_t(n);
+  }
+  return true;
+}
+
+static bool send_u32(int fd, std::uint32_t v) {
+  unsigned char b[4] = {static_cast<unsigned char>(v),
+                        static_cast<unsigned char>(v >> 8),
+                        static_cast<unsigned char>(v >> 16),
+                        static_cast<unsigned char>(v >> 24)};
+  return write_all(fd, reinterpret_cast<char *>(b), 4);
+}
+
+static bool recv_u32(int fd, std::uint32_t &v) {
+  unsigned char b[4];
+  if (!read_all(fd, reinterpret_cast<char *>(b), 4))
+    return false;
+  v = std::uint32_t(b[0]) | std::uint32_t(b[1]) << 8 |
+      std::uint32_t(b[2]) << 16 | std::uint32_t(b[3]) << 24;
+  return true;
+}
+
+static bool send_message(int fd, const std::vector<std::string> &parts) {
+  if (!send_u32(fd, std::uint32_t(parts.size())))
+    return false;
+  for (const std::string &part : parts) {
+    if (!send_u32(fd, std::uint32_t(part.size())) ||
+        !write_all(fd, part.data(), part.size()))
+      return false;
+  }
+  return true;
+}
+
+// Anything bigger than this is not a message from our client
+static constexpr std::uint32_t max_part = 1 << 24;
+
+static bool recv_message(int fd, std::vector<std::string> &parts) {
+  std::uint32_t count;
+  if (!recv_u32(fd, count) || count > 4096)
+    return false;
+  parts.resize(count);
+  for (std::string &part : parts) {
+    std::uint32_t size;
+    if (!recv_u32(fd, size) || size > max_part)
+      return false;
+    part.resize(size);
+    if (!read_all(fd, part.data(), size))
+      return false;
+  }
+  return true;
+}
+
+static bool make_address(const std::string &path, sockaddr_un &addr) {
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return false;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+static int connect_to(const std::string &path) {
+  sockaddr_un addr;
+  if (!make_address(path, addr))
+    return -1;
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+std::string Server::socket_path() {
+  if (const char *path = std::getenv("ZURA_SERVER_SOCKET"))
+    return path;
+  if (const char *dir = std::getenv("XDG_RUNTIME_DIR"))
+    return std::string(dir) + "/zura2.sock";
+  return "/tmp/zura2-" + std::to_string(::getuid()) + ".sock";
+}
+
+// One build, run on a pool worker. Only this request's state is touched, so
+// any number of these can run at once.
+static void handle(int fd) {
+  std::vector<std::string> request;
+  if (!recv_message(fd, request) || request.size() < 3 ||
+      request[2] != "build") {
+    send_message(fd, {"-1", "", "Malformed request\n"});
+    return;
+  }
+
+  std::vector<char *> argv;
+  for (std::size_t i = 1; i < request.size(); i++)
+    argv.push_back(request[i].data());
+
+  std::ostringstream out, err;
+  Driver::Options opts;
+  opts.workdir = request[0];
+  int status = -1;
+  bool ok = Driver::parse_args(int(argv.size()), argv.data(), opts, err);
+  if (ok && opts.input == "-") {
+    err << "The server cannot read the client's stdin\n";
+    ok = false;
+  }
+  if (ok)
+    status = Driver::build(opts, out, err);
+
+  send_message(fd, {std::to_string(status), out.str(), err.str()});
+}
+
+static char listening_path[sizeof(sockaddr_un::sun_path)];
+
+static void stop(int) {
+  ::unlink(listening_path);
+  ::_exit(0);
+}
+
+int Server::serve(int argc, char *argv[]) {
+  std::size_t workers = std::thread::hardware_concurrency();
+  std::string path = socket_path();
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      if (!Driver::parse_jobs(argv[++i], workers)) {
+        std::cerr << "Expected a thread count after -j\n";
+        return -1;
+      }
+    } else if (arg[0] == '-') {
+      std::cerr << "Usage: " << argv[0] << " serve [-j n] [socket]\n";
+      return -1;
+    } else {
+      path = arg;
+    }
+  }
+
+  sockaddr_un addr;
+  if (!make_address(path, addr)) {
+    std::cerr << "Socket path is too long: " << path << "\n";
+    return -1;
+  }
+
+  // Only clear the socket out of the way if nobody is answering on it
+  int running = connect_to(path);
+  if (running >= 0) {
+    ::close(running);
+    std::cerr << "A server is already listening on " << path << "\n";
+    return -1;
+  }
+  ::unlink(path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 ||
+      ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      ::listen(fd, 64) < 0) {
+    std::cerr << "Could not listen on " << path << ": " << std::strerror(errno)
+              << "\n";
+    return -1;
+  }
+
+  std::memcpy(listening_path, addr.sun_path, sizeof(listening_path));
+  std::signal(SIGINT, stop);
+  std::signal(SIGTERM, stop);
+  std::signal(SIGPIPE, SIG_IGN); // a client that hangs up must not kill us
+
+  // Pay for the one time setup now rather than in the first request
+  Codegen::init_native_target();
+  Cache::compiler_id();
+
+  Thread::Pool pool(workers);
+  std::cout << "Listening on " << path << " with " << pool.size()
+            << " workers" << std::endl;
+
+  while (true) {
+    int client = ::accept(fd, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+    pool.submit([client] {
+      handle(client);
+      ::close(client);
+    });
+  }
+
+  ::close(fd);
+  ::unlink(path.c_str());
+  return -1;
+}
+
+int Server::forward(int argc, char *argv[]) {
+  std::vector<char *> args;
+  for (int i = 0; i < argc; i++) {
+    if (std::strcmp(argv[i], "--server") != 0)
+      args.push_back(argv[i]);
+  }
+
+  Driver::Options opts;
+  if (!Driver::parse_args(int(args.size()), args.data(), opts))
+    return -1;
+  // Only this process can read its stdin, and timings of a build are only
+  // taken in the process that runs it
+  if (opts.input == "-" || opts.time_report || opts.mem_report ||
+      !opts.trace.empty())
+    return Driver::run(opts);
+
+  int fd = connect_to(socket_path());
+  if (fd < 0) {
+    std::cerr << "No zura2 server on " << socket_path()
+              << ", building locally\n";
+    return Driver::run(opts);
+  }
+
+  llvm::SmallString<256> cwd;
+  llvm::sys::fs::current_path(cwd);
+  std::vector<std::string> request = {std::string(cwd)};
+  request.insert(request.end(), args.begin(), args.end());
+
+  std::vector<std::string> response;
+  bool ok = send_message(fd, request) && recv_message(fd, response) &&
+            response.size() == 3;
+  ::close(fd);
+  if (!ok) {
+    std::cerr << "Lost the connection to the zura2 server\n";
+    return -1;
+  }
+
+  std::cout << response[1] << std::flush;
+  std::cerr << response[2] << std::flush;
+  return std::atoi(response[0].c_str());
+}
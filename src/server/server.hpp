@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+/*
+ * zura2 serve [-j n] [socket]
+ * zura2 build --server <file> [flags]
+ *
+ * The server stays up with LLVM initialized and a TargetMachine per worker,
+ * so short builds skip process and LLVM startup. Clients send their argv
+ * and working directory over a Unix domain socket and get back the exit
+ * status and everything the build printed. Each request still gets its own
+ * arena and LLVMContext, so the server does not grow with every build.
+ *
+ * Every message is a u32 count of strings, each a u32 length and its bytes:
+ *
+ *   request   cwd, argv[0], "build", args...
+ *   response  status, stdout, stderr
+ */
+
+namespace Server {
+// $ZURA_SERVER_SOCKET, $XDG_RUNTIME_DIR/zura2.sock or /tmp/zura2-<uid>.sock
+std::string socket_path();
+
+int serve(int argc, char *argv[]);
+
+// Runs `zura2 build` on the server, building locally if none is running
+int forward(int argc, char *argv[]);
+}; // namespace Server
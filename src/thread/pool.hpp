@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Thread {
+// A fixed set of workers pulling tasks off a shared queue. Tasks must not
+// throw; report failures through whatever the task captures.
+class Pool {
+public:
+  explicit Pool(std::size_t workers) {
+    if (workers == 0)
+      workers = 1;
+    for (std::size_t i = 0; i < workers; i++)
+      threads.emplace_back([this] { work(); });
+  }
+
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+  void submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push(std::move(task));
+      pending++;
+    }
+    ready.notify_one();
+  }
+
+  // Blocks until every submitted task has finished
+  void wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return pending == 0; });
+  }
+
+  std::size_t size() const { return threads.size(); }
+
+  ~Pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread &t : threads)
+      t.join();
+  }
+
+private:
+  std::vector<std::thread> threads;
+  std::queue<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable idle;
+  std::size_t pending = 0;
+  bool stopping = false;
+
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+          return;
+        task = std::move(tasks.front());
+        tasks.pop();
+      }
+
+      task();
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0)
+        idle.notify_all();
+    }
+  }
+};
+
+// Runs fn(0) .. fn(count - 1) on up to `jobs` threads and waits for them
+inline void parallel_for(std::size_t count, std::size_t jobs,
+                         const std::function<void(std::size_t)> &fn) {
+  if (jobs <= 1 || count <= 1) {
+    for (std::size_t i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  Pool pool(std::min(jobs, count));
+  for (std::size_t i = 0; i < count; i++)
+    pool.submit([&fn, i] { fn(i); });
+  pool.wait();
+}
+} // namespace Thread
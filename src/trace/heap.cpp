@@ -0,0 +1,91 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#include "trace.hpp"
+
+// Replaces the global operator new and delete in all but their aligned
+// forms. Every one is replaced, not just the two the others forward to by
+// default, as sanitizers replace them all. LLVM allocates through the same
+// operators, so its heap is counted too.
+
+namespace {
+std::atomic<bool> counting{false};
+std::atomic<std::uint64_t> allocated{0}, allocations{0};
+// Blocks from before counting started can be freed while it runs, so live
+// may dip below zero
+std::atomic<std::int64_t> live{0}, peak_live{0};
+thread_local std::uint64_t thread_bytes = 0;
+
+void note_alloc(void *p) {
+  auto size = std::uint64_t(malloc_usable_size(p));
+  thread_bytes += size;
+  allocated.fetch_add(size, std::memory_order_relaxed);
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  std::int64_t now =
+      live.fetch_add(std::int64_t(size), std::memory_order_relaxed) +
+      std::int64_t(size);
+  std::int64_t peak = peak_live.load(std::memory_order_relaxed);
+  while (now > peak && !peak_live.compare_exchange_weak(
+                           peak, now, std::memory_order_relaxed)) {
+  }
+}
+} // namespace
+
+void Trace::count_heap() { counting = true; }
+
+Trace::Heap Trace::heap() {
+  std::int64_t peak = peak_live.load();
+  return {allocated.load(), allocations.load(),
+          peak > 0 ? std::uint64_t(peak) : 0};
+}
+
+std::uint64_t Trace::thread_allocated() { return thread_bytes; }
+
+void *operator new(std::size_t size) {
+  while (true) {
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p != nullptr) {
+      if (counting.load(std::memory_order_relaxed))
+        note_alloc(p);
+      return p;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void operator delete(void *p) noexcept {
+  if (p != nullptr && counting.load(std::memory_order_relaxed))
+    live.fetch_sub(std::int64_t(malloc_usable_size(p)),
+                   std::memory_order_relaxed);
+  std::free(p);
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  operator delete(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  operator delete(p);
+}
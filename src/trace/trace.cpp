@@ -0,0 +1,454 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <llvm/ADT/Any.h>
+#include <llvm/Analysis/LazyCallGraph.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace Trace;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr std::int64_t granularity = 20; // us, see write()
+
+// Times are in microseconds, starts relative to start()
+struct Event {
+  Kind kind;
+  std::string name, detail;
+  std::int64_t start, wall, cpu;
+  // In bytes, only sampled for --mem-report
+  std::int64_t peak_rss, raised_rss, heap;
+};
+
+struct Open {
+  Kind kind;
+  std::string name, detail;
+  std::int64_t start, cpu;
+  std::int64_t nested_wall = 0, nested_cpu = 0; // in passes it ran
+  std::int64_t peak_rss = 0, heap = 0;
+};
+
+struct Totals {
+  std::size_t count = 0;
+  std::int64_t wall = 0, cpu = 0;
+};
+
+// Every thread records into a buffer of its own, which outlives the thread
+// so pool workers can come and go during a build
+struct Buffer {
+  std::uint32_t tid;
+  std::vector<Open> open;
+  std::vector<Event> events;
+  std::map<std::string, Totals> passes; // self time, by pass name
+};
+
+std::atomic<bool> on{false};
+bool with_memory = false;
+Clock::time_point epoch;
+std::int64_t epoch_cpu;
+std::mutex lock;
+std::vector<std::unique_ptr<Buffer>> buffers;
+thread_local Buffer *mine = nullptr;
+
+// Counters in the order they were first reported
+std::vector<std::pair<std::string, std::uint64_t>> counters;
+
+Buffer &buffer() {
+  if (mine == nullptr) {
+    std::lock_guard<std::mutex> guard(lock);
+    buffers.push_back(std::make_unique<Buffer>());
+    buffers.back()->tid = std::uint32_t(buffers.size());
+    mine = buffers.back().get();
+  }
+  return *mine;
+}
+
+std::int64_t now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                               epoch)
+      .count();
+}
+
+std::int64_t micros(const timeval &tv) {
+  return std::int64_t(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+std::int64_t thread_cpu() {
+  timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return std::int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+std::int64_t rusage_cpu(int who) {
+  rusage usage;
+  ::getrusage(who, &usage);
+  return micros(usage.ru_utime) + micros(usage.ru_stime);
+}
+
+// Children only show up here once they have been waited for
+std::int64_t span_cpu(Kind kind) {
+  if (kind == Kind::region)
+    return 0;
+  std::int64_t cpu = thread_cpu();
+  if (kind == Kind::subprocess)
+    cpu += rusage_cpu(RUSAGE_CHILDREN);
+  return cpu;
+}
+
+bool is_pass(Kind kind) { return kind == Kind::pass || kind == Kind::analysis; }
+
+bool is_phase(Kind kind) {
+  return kind == Kind::phase || kind == Kind::subprocess;
+}
+
+std::int64_t peak_rss() {
+  rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+  return std::int64_t(usage.ru_maxrss) * 1024;
+}
+
+const char *category(Kind kind) {
+  switch (kind) {
+  case Kind::region:
+    return "region";
+  case Kind::phase:
+    return "phase";
+  case Kind::subprocess:
+    return "subprocess";
+  case Kind::function:
+    return "function";
+  case Kind::pass:
+    return "pass";
+  case Kind::analysis:
+    return "analysis";
+  }
+  return "";
+}
+
+// What a pass is running over, for the trace
+llvm::StringRef unit_name(const llvm::Any &ir) {
+  if (llvm::any_isa<const llvm::Function *>(ir))
+    return llvm::any_cast<const llvm::Function *>(ir)->getName();
+  if (llvm::any_isa<const llvm::Module *>(ir))
+    return llvm::any_cast<const llvm::Module *>(ir)->getName();
+  if (llvm::any_isa<const llvm::Loop *>(ir))
+    return llvm::any_cast<const llvm::Loop *>(ir)
+        ->getHeader()
+        ->getParent()
+        ->getName();
+  if (llvm::any_isa<const llvm::LazyCallGraph::SCC *>(ir)) {
+    auto *scc = llvm::any_cast<const llvm::LazyCallGraph::SCC *>(ir);
+    if (scc->size() > 0)
+      return scc->begin()->getFunction().getName();
+  }
+  return "";
+}
+
+std::string json_text(const std::string &s) {
+  return llvm::json::isUTF8(s) ? s : llvm::json::fixUTF8(s);
+}
+
+// Every recorded event, oldest first
+std::vector<const Event *> all_events() {
+  std::vector<const Event *> events;
+  for (const auto &b : buffers) {
+    for (const Event &e : b->events)
+      events.push_back(&e);
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event *a, const Event *b) {
+                     return a->start < b->start;
+                   });
+  return events;
+}
+
+void row(std::ostream &out, std::int64_t wall, std::int64_t cpu,
+         std::size_t count, const std::string &name) {
+  out << std::setw(12) << double(wall) / 1000.0 << std::setw(12)
+      << double(cpu) / 1000.0 << std::setw(10) << count << "  " << name
+      << "\n";
+}
+
+void header(std::ostream &out, const char *title, const char *what) {
+  out << "===- " << title << " -===\n"
+      << std::setw(12) << "Wall (ms)" << std::setw(12) << "CPU (ms)"
+      << std::setw(10) << "Count"
+      << "  " << what << "\n";
+}
+} // namespace
+
+void Trace::start(bool memory) {
+  with_memory = memory;
+  if (memory)
+    count_heap();
+  epoch = Clock::now();
+  epoch_cpu = rusage_cpu(RUSAGE_SELF) + rusage_cpu(RUSAGE_CHILDREN);
+  on = true;
+}
+
+bool Trace::enabled() { return on.load(std::memory_order_relaxed); }
+
+bool Trace::memory() { return enabled() && with_memory; }
+
+void Trace::begin(Kind kind, llvm::StringRef name, llvm::StringRef detail) {
+  Buffer &b = buffer();
+  b.open.push_back({kind, name.str(), detail.str(), now(), span_cpu(kind)});
+  if (with_memory && is_phase(kind)) {
+    b.open.back().peak_rss = peak_rss();
+    b.open.back().heap = std::int64_t(thread_allocated());
+  }
+}
+
+void Trace::end() {
+  Buffer &b = buffer();
+  if (b.open.empty())
+    return;
+  Open o = std::move(b.open.back());
+  b.open.pop_back();
+  std::int64_t wall = now() - o.start;
+  std::int64_t cpu = span_cpu(o.kind) - o.cpu;
+
+  if (is_pass(o.kind)) {
+    Totals &t = b.passes[o.name];
+    t.count++;
+    t.wall += wall - o.nested_wall;
+    t.cpu += cpu - o.nested_cpu;
+    if (!b.open.empty()) {
+      b.open.back().nested_wall += wall;
+      b.open.back().nested_cpu += cpu;
+    }
+    if (wall < granularity)
+      return;
+  }
+  std::int64_t peak = 0, raised = 0, heap = 0;
+  if (with_memory && is_phase(o.kind)) {
+    peak = peak_rss();
+    raised = peak - o.peak_rss;
+    heap = std::int64_t(thread_allocated()) - o.heap;
+  }
+  b.events.push_back({o.kind, std::move(o.name), std::move(o.detail), o.start,
+                      wall, cpu, peak, raised, heap});
+}
+
+void Trace::count(llvm::StringRef name, std::uint64_t n) {
+  if (!memory())
+    return;
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto &counter : counters) {
+    if (counter.first == name) {
+      counter.second += n;
+      return;
+    }
+  }
+  counters.push_back({name.str(), n});
+}
+
+void Trace::instrument(llvm::PassInstrumentationCallbacks &pic) {
+  if (!enabled())
+    return;
+  pic.registerBeforeNonSkippedPassCallback(
+      [](llvm::StringRef pass, llvm::Any ir) {
+        begin(Kind::pass, pass, unit_name(ir));
+      });
+  pic.registerAfterPassCallback(
+      [](llvm::StringRef, llvm::Any, const llvm::PreservedAnalyses &) {
+        end();
+      });
+  pic.registerAfterPassInvalidatedCallback(
+      [](llvm::StringRef, const llvm::PreservedAnalyses &) { end(); });
+  pic.registerBeforeAnalysisCallback(
+      [](llvm::StringRef analysis, llvm::Any ir) {
+        begin(Kind::analysis, analysis, unit_name(ir));
+      });
+  pic.registerAfterAnalysisCallback([](llvm::StringRef, llvm::Any) { end(); });
+}
+
+void Trace::report(std::ostream &out) {
+  std::vector<const Event *> events = all_events();
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  // Phases in the order they first ran
+  std::vector<std::string> order;
+  std::map<std::string, Totals> phases;
+  std::vector<const Event *> functions;
+  for (const Event *e : events) {
+    if (e->kind == Kind::function)
+      functions.push_back(e);
+    if (e->kind != Kind::phase && e->kind != Kind::subprocess)
+      continue;
+    auto [it, inserted] = phases.emplace(e->name, Totals());
+    if (inserted)
+      order.push_back(e->name);
+    it->second.count++;
+    it->second.wall += e->wall;
+    it->second.cpu += e->cpu;
+  }
+
+  header(out, "Phases", "Phase");
+  for (const std::string &name : order)
+    row(out, phases[name].wall, phases[name].cpu, phases[name].count, name);
+  std::int64_t cpu =
+      rusage_cpu(RUSAGE_SELF) + rusage_cpu(RUSAGE_CHILDREN) - epoch_cpu;
+  row(out, now(), cpu, 1, "Total");
+
+  std::map<std::string, Totals> passes;
+  for (const auto &b : buffers) {
+    for (const auto &[name, t] : b->passes) {
+      Totals &sum = passes[name];
+      sum.count += t.count;
+      sum.wall += t.wall;
+      sum.cpu += t.cpu;
+    }
+  }
+  std::vector<std::pair<std::string, Totals>> slowest(passes.begin(),
+                                                      passes.end());
+  std::sort(slowest.begin(), slowest.end(), [](const auto &a, const auto &b) {
+    return a.second.wall > b.second.wall;
+  });
+  if (!slowest.empty()) {
+    out << "\n";
+    header(out, "Slowest LLVM passes, self time", "Pass");
+    for (std::size_t i = 0; i < slowest.size() && i < 20; i++)
+      row(out, slowest[i].second.wall, slowest[i].second.cpu,
+          slowest[i].second.count, slowest[i].first);
+  }
+
+  std::stable_sort(functions.begin(), functions.end(),
+                   [](const Event *a, const Event *b) {
+                     return a->wall > b->wall;
+                   });
+  if (!functions.empty()) {
+    out << "\n";
+    header(out, "Slowest functions to lower", "Function");
+    for (std::size_t i = 0; i < functions.size() && i < 10; i++)
+      row(out, functions[i]->wall, functions[i]->cpu, 1, functions[i]->name);
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool Trace::write(const std::string &path, std::ostream &err) {
+  std::error_code EC;
+  llvm::raw_fd_ostream os(path, EC);
+  if (EC) {
+    err << "Could not write " << path << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  std::int64_t pid = ::getpid();
+  llvm::json::OStream j(os);
+  j.object([&] {
+    j.attribute("displayTimeUnit", "ms");
+    j.attributeArray("traceEvents", [&] {
+      for (const auto &b : buffers) {
+        j.object([&] {
+          j.attribute("ph", "M");
+          j.attribute("name", "thread_name");
+          j.attribute("pid", pid);
+          j.attribute("tid", std::int64_t(b->tid));
+          j.attributeObject("args", [&] {
+            j.attribute("name", "thread " + std::to_string(b->tid));
+          });
+        });
+      }
+      for (const auto &b : buffers) {
+        for (const Event &e : b->events) {
+          j.object([&] {
+            j.attribute("ph", "X");
+            j.attribute("name", json_text(e.name));
+            j.attribute("cat", category(e.kind));
+            j.attribute("pid", pid);
+            j.attribute("tid", std::int64_t(b->tid));
+            j.attribute("ts", e.start);
+            j.attribute("dur", e.wall);
+            j.attributeObject("args", [&] {
+              if (!e.detail.empty())
+                j.attribute("detail", json_text(e.detail));
+              if (e.kind != Kind::region)
+                j.attribute("cpu_us", e.cpu);
+              if (with_memory && is_phase(e.kind)) {
+                j.attribute("peak_rss", e.peak_rss);
+                j.attribute("heap", e.heap);
+              }
+            });
+          });
+        }
+      }
+    });
+  });
+  os << "\n";
+  return true;
+}
+
+void Trace::memory_report(std::ostream &out) {
+  auto mib = [](std::int64_t bytes) { return double(bytes) / 1048576.0; };
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(1);
+
+  Heap h = heap();
+  out << "===- Memory -===\n"
+      << "  Peak RSS        " << std::setw(10) << mib(peak_rss()) << " MiB\n"
+      << "  Heap allocated  " << std::setw(10) << mib(std::int64_t(h.allocated))
+      << " MiB in " << h.allocations << " allocations\n"
+      << "  Heap peak live  " << std::setw(10) << mib(std::int64_t(h.peak_live))
+      << " MiB\n";
+
+  // Phases in the order they first ran
+  struct Phase {
+    std::size_t count = 0;
+    std::int64_t peak = 0, raised = 0, heap = 0;
+  };
+  std::vector<std::string> order;
+  std::map<std::string, Phase> phases;
+  for (const Event *e : all_events()) {
+    if (!is_phase(e->kind))
+      continue;
+    auto [it, inserted] = phases.emplace(e->name, Phase());
+    if (inserted)
+      order.push_back(e->name);
+    Phase &p = it->second;
+    p.count++;
+    p.peak = std::max(p.peak, e->peak_rss);
+    p.raised += e->raised_rss;
+    p.heap += e->heap;
+  }
+
+  out << "\n===- Phases -===\n"
+      << std::setw(16) << "Peak RSS (MiB)" << std::setw(14) << "Raised (MiB)"
+      << std::setw(12) << "Heap (MiB)" << std::setw(10) << "Count"
+      << "  Phase\n";
+  for (const std::string &name : order) {
+    const Phase &p = phases[name];
+    out << std::setw(16) << mib(p.peak) << std::setw(14) << mib(p.raised)
+        << std::setw(12) << mib(p.heap) << std::setw(10) << p.count << "  "
+        << name << "\n";
+  }
+
+  if (!counters.empty()) {
+    out << "\n===- Counters -===\n"
+        << std::setw(16) << "Value"
+        << "  Counter\n";
+    for (const auto &[name, value] : counters)
+      out << std::setw(16) << value << "  " << name << "\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <llvm/ADT/StringRef.h>
+#include <string>
+
+namespace llvm {
+class PassInstrumentationCallbacks;
+}
+
+/*
+ * Compile time tracing, behind --time-report and --trace=<file>
+ *
+ * A Scope times whatever runs on its thread while it is alive, in wall
+ * time and in CPU time of that thread. Scopes are put around work that
+ * runs on a single thread (lexing one module, parsing one chunk, lowering
+ * one partition) so the CPU time means something at any -j. Regions only
+ * show how that work nests in the trace and get no CPU time.
+ *
+ * LLVM passes are timed through the pass instrumentation of the new pass
+ * manager. They are reported by self time, so pass managers and adaptors
+ * do not count the passes they run a second time.
+ *
+ * Until start() is called a Scope does nothing but check a flag.
+ *
+ * For --mem-report, phases also sample the peak RSS of the process and the
+ * heap their thread allocated through operator new (heap.cpp). A phase
+ * that raised the peak is charged for it, which with -j above 1 may be a
+ * phase running next to the one to blame. Counters add up whatever sizes
+ * the build reports (tokens, arena blocks, IR instructions, ...).
+ */
+
+namespace Trace {
+enum class Kind {
+  region,     // encloses other spans, wall time only
+  phase,      // one piece of a build on one thread
+  subprocess, // a phase that waits on a child, which it is charged for
+  function,   // lowering one function
+  pass,       // an LLVM pass over one IR unit
+  analysis,   // an LLVM analysis over one IR unit
+};
+
+void start(bool memory = false);
+bool enabled();
+bool memory();
+
+// Opens and closes a span on the calling thread, spans nest
+void begin(Kind kind, llvm::StringRef name, llvm::StringRef detail = "");
+void end();
+
+class Scope {
+public:
+  Scope(Kind kind, llvm::StringRef name, llvm::StringRef detail = "")
+      : active(enabled()) {
+    if (active)
+      begin(kind, name, detail);
+  }
+  // Shorthand for the common case
+  explicit Scope(llvm::StringRef name, llvm::StringRef detail = "")
+      : Scope(Kind::phase, name, detail) {}
+  ~Scope() {
+    if (active)
+      end();
+  }
+
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  bool active;
+};
+
+// Times every pass the pass manager built with `pic` runs. Does nothing
+// unless tracing was started.
+void instrument(llvm::PassInstrumentationCallbacks &pic);
+
+// Adds n to a named counter, for the memory report. Does nothing unless
+// memory() is on.
+void count(llvm::StringRef name, std::uint64_t n);
+
+// Every allocation through operator new, counted only while memory() is on
+struct Heap {
+  std::uint64_t allocated, allocations, peak_live;
+};
+Heap heap();
+std::uint64_t thread_allocated(); // by the calling thread
+void count_heap();                // start(true) calls it
+
+// Phase totals, the slowest passes and the slowest functions. Only call
+// once every thread that recorded spans is done.
+void report(std::ostream &out);
+
+// Chrome trace-event JSON, for Perfetto or chrome://tracing. Passes and
+// analyses shorter than 20us are left out to keep the file small, they
+// still count towards the report.
+bool write(const std::string &path, std::ostream &err);
+
+// Peak RSS, heap traffic, what each phase added to them, and the counters
+void memory_report(std::ostream &out);
+} // namespace Trace
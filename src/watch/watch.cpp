@@ -0,0 +1,342 @@
+#include "watch.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../ast/stmt.hpp"
+#include "../cache/cache.hpp"
+#include "../driver/driver.hpp"
+#include "../driver/module.hpp"
+#include "../error/error.hpp"
+#include "../lexer/lexer.hpp"
+#include "../memory/memory.hpp"
+#include "../parser/parser.hpp"
+
+using namespace Allocator;
+
+// How long the source has to stay quiet before a rebuild starts
+static constexpr int debounce_ms = 50;
+
+namespace {
+// The stmts of one top level declaration, with the arena that owns them
+struct Chunk {
+  std::unique_ptr<ArenaAllocator> arena;
+  std::vector<Node::Stmt *> stmts;
+};
+
+struct State {
+  Driver::Options opts;
+  std::string dir;       // objects of the current build
+  std::string cache_dir; // objects of every function version built so far
+  Driver::Source source; // what the last rebuild saw, a copy never a mapping
+  // The modules it used, kept parsed for the next rebuild. The root is left
+  // out, its declarations live in `chunks`.
+  Driver::Modules modules;
+  // Keyed by the kinds and values of the chunk's tokens. Positions are left
+  // out on purpose, the AST does not store them.
+  std::multimap<std::string, Chunk> chunks;
+};
+
+// Parent directory watch -> names of the files we care about in it
+using Watches = std::map<int, std::set<std::string>>;
+} // namespace
+
+static void add_watch(int fd, const std::string &file, Watches &watches);
+
+static std::string chunk_text(const std::vector<Lexer::Token> &tks,
+                              std::size_t begin, std::size_t end) {
+  std::string text;
+  for (std::size_t i = begin; i < end; i++) {
+    text += std::to_string(tks[i].kind) + ":";
+    // The spelling, since a string's value may hold a NUL itself
+    text.append(tks[i].start, std::size_t(tks[i].length));
+    text.push_back('\0');
+  }
+  return text;
+}
+
+// Fills `parsed` with how many declarations had to be parsed again. The
+// modules the file uses are added to `watches`.
+static int rebuild(State &st, int fd, Watches &watches, std::size_t &parsed,
+                   std::size_t &total) {
+  Error::errors.clear();
+  Error::file = st.opts.input;
+
+  Lexer::lexer lx;
+  lx.init_lexer(&lx, st.source.c_str());
+  std::vector<Lexer::Token> tks;
+  while (true) {
+    Lexer::Token tk = lx.scan_token();
+    tks.push_back(tk);
+    if (tk.kind == Lexer::Kind::eof)
+      break;
+  }
+  if (Error::report_error())
+    return 1; // Lexical Error
+
+  std::vector<std::size_t> starts = Parser::split_top_level(tks, 1);
+  starts.push_back(tks.size() - 1);
+  total = starts.size() - 1;
+
+  // Reuse every declaration whose tokens did not change, parse the rest
+  std::multimap<std::string, Chunk> next;
+  std::vector<Node::Stmt *> stmts;
+  parsed = 0;
+  for (std::size_t i = 0; i + 1 < starts.size(); i++) {
+    std::string text = chunk_text(tks, starts[i], starts[i + 1]);
+    auto node = st.chunks.extract(text);
+    if (node.empty()) {
+      std::vector<Lexer::Token> part(tks.begin() + long(starts[i]),
+                                     tks.begin() + long(starts[i + 1]));
+      part.push_back(tks.back());
+
+      std::size_t errors = Error::errors.size();
+      Chunk chunk{std::make_unique<ArenaAllocator>(1024), {}};
+      chunk.stmts = Parser::parse_stmts(std::move(part), *chunk.arena);
+      parsed++;
+      if (Error::errors.size() != errors)
+        continue; // never keep a declaration that did not parse
+
+      stmts.insert(stmts.end(), chunk.stmts.begin(), chunk.stmts.end());
+      next.emplace(std::move(text), std::move(chunk));
+    } else {
+      const Chunk &chunk = node.mapped();
+      stmts.insert(stmts.end(), chunk.stmts.begin(), chunk.stmts.end());
+      next.insert(std::move(node));
+    }
+  }
+  st.chunks = std::move(next);
+
+  if (Error::report_error())
+    return 2; // Parser Error
+
+  ArenaAllocator arena(1024);
+  Driver::Modules modules;
+  modules.push_back(std::make_unique<Driver::Module>());
+  modules[0]->path = st.opts.input;
+  modules[0]->program = arena.emplace<ProgramStmt>(stmts, arena);
+
+  int status = Driver::load_modules(st.opts, modules, std::cout, std::cerr,
+                                    &st.modules);
+  for (const auto &m : modules)
+    add_watch(fd, m->path, watches);
+  if (status != 0)
+    return status;
+
+  // Every module is compiled with -incremental, which needs all their ASTs
+  std::vector<std::size_t> every(modules.size());
+  std::iota(every.begin(), every.end(), 0);
+  status = Driver::parse_modules(st.opts, modules, every, std::cout);
+  if (status != 0)
+    return status;
+
+  if (st.opts.debug) {
+    for (const auto &m : modules)
+      m->program->debug(std::cout);
+  }
+
+  // Reloaded every time, the runtime may have been rebuilt in between
+  Driver::Runtime runtime;
+  if (!Driver::load_runtime(st.opts, runtime, std::cerr))
+    return -1;
+
+  std::vector<std::vector<std::string>> objects;
+  status = Driver::generate(st.opts, runtime, Driver::units_of(modules),
+                            st.dir, st.cache_dir, objects, std::cerr);
+
+  std::vector<std::string> all;
+  for (const auto &objs : objects)
+    all.insert(all.end(), objs.begin(), objs.end());
+  if (status == 0 && !Driver::link(all, st.opts, runtime, std::cerr))
+    status = -1;
+  if (!st.opts.save) {
+    for (const std::string &object : all)
+      llvm::sys::fs::remove(object);
+  }
+
+  Cache::evict(st.cache_dir, Cache::size_limit());
+  modules[0].reset();
+  st.modules = std::move(modules);
+  return status;
+}
+
+static void add_watch(int fd, const std::string &file, Watches &watches) {
+  std::string dir(llvm::sys::path::parent_path(file));
+  if (dir.empty())
+    dir = ".";
+
+  // Editors often save by renaming a new file over the old one, so watch
+  // the directory rather than the file itself
+  int wd = inotify_add_watch(fd, dir.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (wd < 0) {
+    std::cerr << "Could not watch " << dir << ": " << std::strerror(errno)
+              << "\n";
+    return;
+  }
+  watches[wd].insert(std::string(llvm::sys::path::filename(file)));
+}
+
+// Whether the file or any module it used differs from the last rebuild
+static bool changed(const State &st, const Driver::Source &source) {
+  if (source.text() != st.source.text())
+    return true;
+  for (const auto &m : st.modules) {
+    Driver::Source current;
+    std::ostringstream ignored;
+    if (m != nullptr && (!Driver::read_file(m->path, current, ignored, true) ||
+                         current.text() != m->source.text()))
+      return true;
+  }
+  return false;
+}
+
+// SIGINT and SIGTERM end the session between rebuilds. Their handler
+// writes to this pipe, which the wait for changes polls along with inotify
+// and which stays readable from then on, however late the signal came.
+static int stop_pipe[2] = {-1, -1};
+
+static void stop(int) {
+  char byte = 0;
+  ssize_t written = ::write(stop_pipe[1], &byte, 1);
+  (void)written; // a full pipe is readable already
+}
+
+enum class Wait { change, timeout, stopped, failed };
+
+// Waits up to `timeout_ms` (-1 for ever) for one of the watched files to
+// change. On failed, errno says why.
+static Wait wait_for_change(int fd, const Watches &watches, int timeout_ms) {
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    pollfd pfds[] = {{fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+    int ready = poll(pfds, 2, timeout_ms);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      return Wait::failed;
+    if (ready == 0)
+      return Wait::timeout;
+    if (pfds[1].revents != 0)
+      return Wait::stopped;
+
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return Wait::failed;
+
+    bool changed = false;
+    for (char *p = buffer; p < buffer + n;) {
+      auto *event = reinterpret_cast<inotify_event *>(p);
+      auto it = watches.find(event->wd);
+      if (event->len > 0 && it != watches.end() &&
+          it->second.count(event->name))
+        changed = true;
+      p += sizeof(inotify_event) + event->len;
+    }
+    if (changed)
+      return Wait::change;
+  }
+}
+
+int Watch::run(int argc, char *argv[]) {
+  State st;
+  if (!Driver::parse_args(argc, argv, st.opts))
+    return -1; // Argument issue
+  if (st.opts.input == "-" || st.opts.batch) {
+    std::cerr << "Watch mode needs a single file, not stdin or a batch\n";
+    return -1;
+  }
+  st.opts.incremental = true;
+
+  llvm::SmallString<128> prefix, dir;
+  llvm::sys::path::system_temp_directory(true, prefix);
+  llvm::sys::path::append(prefix, "zura2-watch");
+  if (auto EC = llvm::sys::fs::createUniqueDirectory(prefix, dir)) {
+    std::cerr << "Could not create a temporary directory: " << EC.message()
+              << "\n";
+    return 4;
+  }
+  st.dir = std::string(dir);
+
+  // Without the shared cache, keep the function objects for this session.
+  // Either way they go with the directory when the session ends.
+  st.cache_dir = st.opts.cache ? Cache::directory() : "";
+  if (st.cache_dir.empty())
+    st.cache_dir = st.dir + "/cache";
+  struct Remove {
+    std::string dir;
+    ~Remove() { llvm::sys::fs::remove_directories(dir); }
+  } remove{st.dir};
+  if (::pipe2(stop_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    std::cerr << "Could not create a pipe: " << std::strerror(errno) << "\n";
+    return -1;
+  }
+  std::signal(SIGINT, stop);
+  std::signal(SIGTERM, stop);
+
+  int fd = inotify_init1(IN_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "inotify is not available: " << std::strerror(errno) << "\n";
+    return -1;
+  }
+  Watches watches;
+  add_watch(fd, st.opts.input, watches);
+
+  // Every module is part of the build, so a change to any of them counts
+  bool first = true;
+  while (true) {
+    if (!first) {
+      Wait wait = wait_for_change(fd, watches, -1);
+      while (wait == Wait::change)
+        wait = wait_for_change(fd, watches, debounce_ms);
+      if (wait == Wait::stopped)
+        return 0;
+      if (wait == Wait::failed) {
+        std::cerr << "Could not watch for changes: " << std::strerror(errno)
+                  << "\n";
+        return -1;
+      }
+    }
+
+    Driver::Source source;
+    if (!Driver::read_file(st.opts.input, source, std::cerr, true)) {
+      if (first)
+        return -1;
+      continue; // mid rename, the next event will bring it back
+    }
+    if (!first && !changed(st, source))
+      continue;
+    first = false;
+    st.source = std::move(source);
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t parsed = 0, total = 0;
+    int status = rebuild(st, fd, watches, parsed, total);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    if (status == 0)
+      std::cout << "Executable '" << st.opts.output << "' has been rebuilt in "
+                << ms << " ms (" << parsed << " of " << total
+                << " declarations parsed)" << std::endl;
+    std::cout << "Watching " << st.opts.input << " for changes..." << std::endl;
+  }
+}
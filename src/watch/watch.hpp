@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+ * zura2 watch <file> [build flags]
+ *
+ * Builds once, then rebuilds whenever the source or a module it uses is
+ * saved. Bursts of saves are debounced into one rebuild. Between rebuilds
+ * the parsed form of every top level declaration stays in memory and is
+ * reused for as long as its tokens do not change, as do modules whose
+ * source did not change. Code generation runs as with -incremental, so an
+ * edit only reparses and recompiles what it touched before relinking.
+ *
+ * The objects live in a temporary directory, as does the function cache
+ * with -no-cache. Ctrl-C or SIGTERM ends the session and removes it.
+ */
+
+namespace Watch {
+int run(int argc, char *argv[]);
+}; // namespace Watch
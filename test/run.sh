@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+
+# Builds the programs in test/ and checks what they print
+#
+#   test/run.sh [name...]
+#
+# Every <name>.zu here with a <name>.out next to it is built with zura2 and
+# run once for each ZURA_THREADS count, so @parallel loops run both inline
+# and on a pool. Every run has to print <name>.out: stdout and stderr as
+# they were written, then "exit N" when the program exits with N other
+# than 0. A program that must not build has what zura2 prints in
+# <name>.out instead, then "build exit N". Files in test/modules/ are only
+# there for the programs to @use.
+#
+#   ZURA2     the compiler under test, release/zura2 by default
+#   THREADS   the ZURA_THREADS counts, "1 4" by default
+
+cd "$(dirname "$0")/.." || exit 1
+
+ZURA2="${ZURA2:-release/zura2}"
+THREADS="${THREADS:-1 4}"
+
+die() {
+  echo "$1" >&2
+  exit 1
+}
+
+[ -x "$ZURA2" ] || die "No zura2 at $ZURA2, build it or set ZURA2"
+
+TESTS=("$@")
+if [ ${#TESTS[@]} -eq 0 ]; then
+  for out in test/*.out; do
+    TESTS+=("$(basename "$out" .out)")
+  done
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+status=0
+
+# Compares $WORK/<name>.got with test/<name>.out
+check() {
+  if cmp -s "$WORK/$1.got" "test/$1.out"; then
+    echo "ok   $2"
+  else
+    echo "FAIL $2:" >&2
+    diff "test/$1.out" "$WORK/$1.got" >&2
+    status=1
+  fi
+}
+
+for name in "${TESTS[@]}"; do
+  zu="test/$name.zu"
+  expected="test/$name.out"
+  if [ ! -f "$zu" ] || [ ! -f "$expected" ]; then
+    echo "$name: needs both $zu and $expected" >&2
+    status=1
+    continue
+  fi
+
+  "$ZURA2" build "$zu" -o "$WORK/$name" -no-cache >"$WORK/$name.got" 2>&1
+  code=$?
+  if [ "$code" -ne 0 ]; then
+    echo "build exit $code" >>"$WORK/$name.got"
+    check "$name" "$name"
+    continue
+  fi
+
+  for threads in $THREADS; do
+    ZURA_THREADS=$threads "$WORK/$name" >"$WORK/$name.got" 2>&1
+    code=$?
+    if [ "$code" -ne 0 ]; then
+      echo "exit $code" >>"$WORK/$name.got"
+    fi
+    check "$name" "$name, ZURA_THREADS=$threads"
+  done
+done
+
+exit $status